@@ -0,0 +1,53 @@
+#!/usr/bin/env python3
+
+# Compares a run of bench-generator against a baseline run, size by size.
+# Exits with status 1 if any size generated boards more than --threshold
+# percent slower than the baseline.
+
+import argparse
+import json
+import sys
+
+parser = argparse.ArgumentParser(description='Compare two bench-generator runs')
+parser.add_argument('baseline', help='JSON written by an earlier run')
+parser.add_argument('results', help='JSON written by the run to check')
+parser.add_argument('--threshold', type=float, default=10.0,
+                    help='Slowdown in boards/sec, in percent, that counts as a regression')
+args = parser.parse_args()
+
+
+def load(path):
+	with open(path) as f:
+		return {entry['size']: entry for entry in json.load(f)['sizes']}
+
+
+def change(old, new):
+	return (new - old) / old * 100 if old else 0.0
+
+
+baseline = load(args.baseline)
+results = load(args.results)
+regressions = []
+
+print('{:>5} {:>12} {:>12} {:>8} {:>10} {:>10} {:>8}'.format(
+	'size', 'base b/s', 'now b/s', 'change', 'base p99', 'now p99', 'change'))
+
+for size in sorted(results):
+	if size not in baseline:
+		continue
+
+	old, new = baseline[size], results[size]
+	speed = change(old['boards_per_sec'], new['boards_per_sec'])
+	tail = change(old['p99_ms'], new['p99_ms'])
+
+	print('{:>5} {:>12.1f} {:>12.1f} {:>+7.1f}% {:>8.3f}ms {:>8.3f}ms {:>+7.1f}%'.format(
+		size, old['boards_per_sec'], new['boards_per_sec'], speed,
+		old['p99_ms'], new['p99_ms'], tail))
+
+	if speed < -args.threshold:
+		regressions.append(size)
+
+if regressions:
+	print('Slower than the baseline by more than {}% at sizes: {}'.format(
+		args.threshold, ', '.join(str(size) for size in regressions)))
+	sys.exit(1)
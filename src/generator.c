@@ -23,24 +23,55 @@
  */
 
 #include <glib.h>
-#include <stdlib.h>
 #include <string.h>
 
 #include "generator.h"
-#include "main.h"
-#include "rules.h"
+#include "solver.h"
 
-/* Helper to grow a tile */
-static void grow_tile(gint **tile_ids, gboolean **solution, guint size, guint x,
-                      guint y, gint current_tile_id) {
+/* Boards up to this size have tiles grown within one colour of the solution.
+ * On bigger boards that leaves so many single-cell tiles that a board is
+ * almost never unique, so there the tiles are grown regardless of colour, up
+ * to half the board size in cells, and then each is painted as a whole. */
+#define CLASSIC_MAX_SIZE 10
+
+/* Uniqueness checks visiting more nodes than this count the board as
+ * ambiguous, so that every attempt takes bounded time. Only boards well
+ * beyond CLASSIC_MAX_SIZE ever come close. */
+#define SOLVER_NODE_BUDGET (1u << 20)
+
+/* Solver nodes visited between polls for cancellation */
+#define REPAIR_STEP_NODES 4096
+
+/* How many tiles an ambiguous board may have merged before it is given up on.
+ * Each merge rules out at least the second solution the solver found. */
+#define REPAIR_MAX_EDITS 8
+
+/* How many attempts may be passed over for being of the wrong difficulty
+ * before any unique board will do. Some bands hardly occur at some sizes:
+ * a 3×3 board never needs trial and error, and a 30×30 one is rarely easy. */
+#define DIFFICULTY_MAX_ATTEMPTS 512
+
+/* The last board generated at each size, turned and mirrored to fall back on
+ * when a later generation runs out of time and there's no ready-made board */
+G_LOCK_DEFINE_STATIC(fallback_boards);
+static TilepaintPuzzle *fallback_boards[TILEPAINT_PUZZLE_MAX_SIZE + 1];
+
+/* Marks a cell not yet in any tile while tiles are grown */
+#define NO_TILE G_MAXUINT16
+
+typedef struct {
+  guint x;
+  guint y;
+} Point;
+
+/* Helper to grow a tile. tile_ids and solution are laid out as in
+ * TilepaintPuzzle, and queue has room for every cell. */
+static void grow_tile(GRand *rng, guint16 *tile_ids, const guchar *solution,
+                      Point *queue, guint size, guint x, guint y,
+                      guint16 current_tile_id, gboolean any_colour,
+                      guint max_cells) {
   /* Randomly try to add neighbors of the same color to this tile */
   /* Uses a simple queue for BFS growth with probability */
-
-  typedef struct {
-    guint x;
-    guint y;
-  } Point;
-  Point *queue = g_new(Point, size * size);
   guint q_start = 0;
   guint q_end = 0;
 
@@ -56,286 +87,1053 @@ static void grow_tile(gint **tile_ids, gboolean **solution, guint size, guint x,
     for (int i = 0; i < 4; i++) {
       guint nx = neighbors[i].x;
       guint ny = neighbors[i].y;
+      guint n = nx * size + ny;
 
       if (nx >= size || ny >= size)
         continue;
 
-      if (tile_ids[nx][ny] == -1 && solution[nx][ny] == solution[x][y]) {
+      if (tile_ids[n] == NO_TILE &&
+          (any_colour || solution[n] == solution[x * size + y]) &&
+          q_end < max_cells) {
         /* 70% chance to merge, preventing huge monolithic tiles */
-        if ((rand() % 100) < 70) {
-          tile_ids[nx][ny] = current_tile_id;
+        if (g_rand_int_range(rng, 0, 100) < 70) {
+          tile_ids[n] = current_tile_id;
           queue[q_end++] = (Point){nx, ny};
         }
       }
     }
   }
-  g_free(queue);
 }
 
-/* Solver context for uniqueness check */
-typedef struct {
-  guint size;
-  guint num_tiles;
-  guchar *row_clues;
-  guchar *col_clues;
-  int **tile_row_map; /* tile_id -> row -> count */
-  int **tile_col_map; /* tile_id -> col -> count */
-  int *current_row_sums;
-  int *current_col_sums;
-  int *remaining_row_tiles_sum; /* potential left in unassigned tiles for this
-                                   row */
-  int *remaining_col_tiles_sum;
-  int solutions_found;
-} SolverCtx;
-
-static void solve_recursive(SolverCtx *ctx, guint tile_idx) {
-  if (ctx->solutions_found > 1)
-    return;
+TilepaintPuzzle *tilepaint_puzzle_new(guint size) {
+  TilepaintPuzzle *puzzle = g_new0(TilepaintPuzzle, 1);
 
-  if (tile_idx == ctx->num_tiles) {
-    /* All tiles assigned, verify all clues matched (pruning should have handled
-     * this, but check anyway) */
-    for (guint i = 0; i < ctx->size; i++) {
-      if (ctx->current_row_sums[i] != ctx->row_clues[i] ||
-          ctx->current_col_sums[i] != ctx->col_clues[i])
-        return;
-    }
-    ctx->solutions_found++;
+  puzzle->size = size;
+  puzzle->tile_ids = g_new0(guint16, size * size);
+  puzzle->solution = g_new0(guchar, size * size);
+  puzzle->row_clues = g_new0(guchar, size);
+  puzzle->col_clues = g_new0(guchar, size);
+
+  return puzzle;
+}
+
+void tilepaint_puzzle_free(TilepaintPuzzle *puzzle) {
+  if (puzzle == NULL)
     return;
+
+  g_free(puzzle->tile_ids);
+  g_free(puzzle->solution);
+  g_free(puzzle->row_clues);
+  g_free(puzzle->col_clues);
+  g_free(puzzle);
+}
+
+/* Renumbers the tiles in order of their first cell, as they are numbered when
+ * grown */
+static void renumber_tiles(TilepaintPuzzle *puzzle) {
+  guint n_cells = puzzle->size * puzzle->size;
+  guint16 *new_ids = g_new(guint16, n_cells);
+  guint16 n_tiles = 0;
+  guint i;
+
+  for (i = 0; i < n_cells; i++)
+    new_ids[i] = G_MAXUINT16;
+
+  for (i = 0; i < n_cells; i++) {
+    guint16 *id = &new_ids[puzzle->tile_ids[i]];
+
+    if (*id == G_MAXUINT16)
+      *id = n_tiles++;
+    puzzle->tile_ids[i] = *id;
   }
 
-  /* Try Unpainted (0) */
-  gboolean possible = TRUE;
-  for (guint i = 0; i < ctx->size; i++) {
-    /* If we DON'T paint this tile, can we still reach the required row/col
-     * clues? */
-    ctx->remaining_row_tiles_sum[i] -= ctx->tile_row_map[tile_idx][i];
-    ctx->remaining_col_tiles_sum[i] -= ctx->tile_col_map[tile_idx][i];
+  puzzle->num_tiles = n_tiles;
+  g_free(new_ids);
+}
+
+/* Copies a board, turned or mirrored: bit 0 of transform swaps x and y, bit 1
+ * mirrors x and bit 2 mirrors y, so 0 to 7 give all eight. The copy is unique
+ * if the board is, but isn't rated, as the solver may take another path
+ * through it. */
+TilepaintPuzzle *tilepaint_puzzle_transform(const TilepaintPuzzle *puzzle,
+                                            guint transform) {
+  guint size;
+  TilepaintPuzzle *copy;
+  guint x, y;
+
+  g_return_val_if_fail(puzzle != NULL, NULL);
+  g_return_val_if_fail(transform < 8, NULL);
+
+  size = puzzle->size;
+  copy = tilepaint_puzzle_new(size);
+
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      guint tx = transform & 1 ? y : x;
+      guint ty = transform & 1 ? x : y;
+      guint from = x * size + y, to;
+
+      if (transform & 2)
+        tx = size - 1 - tx;
+      if (transform & 4)
+        ty = size - 1 - ty;
 
-    if (ctx->current_row_sums[i] + ctx->remaining_row_tiles_sum[i] <
-            ctx->row_clues[i] ||
-        ctx->current_col_sums[i] + ctx->remaining_col_tiles_sum[i] <
-            ctx->col_clues[i]) {
-      possible = FALSE;
+      to = tx * size + ty;
+      copy->tile_ids[to] = puzzle->tile_ids[from];
+      copy->solution[to] = puzzle->solution[from];
+      copy->col_clues[tx] += copy->solution[to];
+      copy->row_clues[ty] += copy->solution[to];
     }
   }
 
-  if (possible) {
-    solve_recursive(ctx, tile_idx + 1);
-  }
+  renumber_tiles(copy);
+
+  return copy;
+}
+
+/* Lays a board out as bytes that compare, with memcmp(), equal only for the
+ * same tiles, solution and clues: 2-byte big-endian tile ids, numbered in
+ * cell order, then the solution, then the row and column clues */
+static gsize puzzle_encoding_length(guint size) {
+  return 3 * size * size + 2 * size;
+}
 
-  /* Backtrack state for unpainted check */
-  for (guint i = 0; i < ctx->size; i++) {
-    ctx->remaining_row_tiles_sum[i] += ctx->tile_row_map[tile_idx][i];
-    ctx->remaining_col_tiles_sum[i] += ctx->tile_col_map[tile_idx][i];
+static void puzzle_encode(const TilepaintPuzzle *puzzle, guchar *encoding) {
+  guint n_cells = puzzle->size * puzzle->size;
+  guint i;
+
+  for (i = 0; i < n_cells; i++) {
+    *encoding++ = puzzle->tile_ids[i] >> 8;
+    *encoding++ = puzzle->tile_ids[i] & 0xff;
   }
 
-  if (ctx->solutions_found > 1)
-    return;
+  memcpy(encoding, puzzle->solution, n_cells);
+  memcpy(encoding + n_cells, puzzle->row_clues, puzzle->size);
+  memcpy(encoding + n_cells + puzzle->size, puzzle->col_clues, puzzle->size);
+}
+
+/* A 64-bit fingerprint of a board's tiles, solution and clues, which is the
+ * same for all eight ways of turning and mirroring it: the FNV-1a hash of
+ * whichever of their encodings sorts first. It is never 0, so 0 can mark an
+ * empty slot. */
+guint64 tilepaint_puzzle_fingerprint(const TilepaintPuzzle *puzzle) {
+  gsize length;
+  guchar *best, *encoding;
+  guint64 hash = 14695981039346656037u;
+  guint transform;
+  gsize i;
 
-  /* Try Painted (1) */
-  possible = TRUE;
-  for (guint i = 0; i < ctx->size; i++) {
-    /* If we DO paint this tile, do we exceed any clues? */
-    int new_row_sum = ctx->current_row_sums[i] + ctx->tile_row_map[tile_idx][i];
-    int new_col_sum = ctx->current_col_sums[i] + ctx->tile_col_map[tile_idx][i];
+  g_return_val_if_fail(puzzle != NULL, 0);
 
-    if (new_row_sum > ctx->row_clues[i] || new_col_sum > ctx->col_clues[i]) {
-      possible = FALSE;
+  length = puzzle_encoding_length(puzzle->size);
+  best = g_new(guchar, length);
+  encoding = g_new(guchar, length);
+
+  /* The board as it is goes through tilepaint_puzzle_transform() too, so
+   * that its tiles are numbered in cell order whatever their ids were */
+  for (transform = 0; transform < 8; transform++) {
+    TilepaintPuzzle *copy = tilepaint_puzzle_transform(puzzle, transform);
+
+    puzzle_encode(copy, transform == 0 ? best : encoding);
+    if (transform > 0 && memcmp(encoding, best, length) < 0) {
+      guchar *swap = best;
+
+      best = encoding;
+      encoding = swap;
     }
+
+    tilepaint_puzzle_free(copy);
   }
 
-  if (possible) {
-    /* Assign Painted */
-    for (guint i = 0; i < ctx->size; i++) {
-      ctx->current_row_sums[i] += ctx->tile_row_map[tile_idx][i];
-      ctx->current_col_sums[i] += ctx->tile_col_map[tile_idx][i];
-      ctx->remaining_row_tiles_sum[i] -= ctx->tile_row_map[tile_idx][i];
-      ctx->remaining_col_tiles_sum[i] -= ctx->tile_col_map[tile_idx][i];
-    }
+  for (i = 0; i < length; i++) {
+    hash ^= best[i];
+    hash *= 1099511628211u;
+  }
 
-    solve_recursive(ctx, tile_idx + 1);
+  g_free(best);
+  g_free(encoding);
 
-    /* Backtrack */
-    for (guint i = 0; i < ctx->size; i++) {
-      ctx->current_row_sums[i] -= ctx->tile_row_map[tile_idx][i];
-      ctx->current_col_sums[i] -= ctx->tile_col_map[tile_idx][i];
-      ctx->remaining_row_tiles_sum[i] += ctx->tile_row_map[tile_idx][i];
-      ctx->remaining_col_tiles_sum[i] += ctx->tile_col_map[tile_idx][i];
-    }
+  return hash != 0 ? hash : 1;
+}
+
+static void remember_board(const TilepaintPuzzle *puzzle) {
+  G_LOCK(fallback_boards);
+  tilepaint_puzzle_free(fallback_boards[puzzle->size]);
+  fallback_boards[puzzle->size] = tilepaint_puzzle_transform(puzzle, 0);
+  G_UNLOCK(fallback_boards);
+}
+
+/* Returns a board to give once out of time, or NULL if there is none. A
+ * ready-made one from `fallback`, if given, hasn't been played yet, so it comes
+ * first. Otherwise the board last generated at this size is turned or
+ * mirrored by seed, so as not to look the same, and rated afresh. */
+static TilepaintPuzzle *fallback_board(guint size, guint seed,
+                                       TilepaintGeneratorFallbackFunc fallback,
+                                       gpointer fallback_data,
+                                       TilepaintGeneratorStats *stats) {
+  TilepaintSolverStats check = {0};
+  TilepaintPuzzle *puzzle = NULL;
+
+  if (fallback != NULL) {
+    puzzle = fallback(size, fallback_data);
+    if (puzzle != NULL)
+      return puzzle;
   }
+
+  G_LOCK(fallback_boards);
+  if (fallback_boards[size] != NULL)
+    puzzle = tilepaint_puzzle_transform(fallback_boards[size], 1 + seed % 7);
+  G_UNLOCK(fallback_boards);
+
+  if (puzzle == NULL)
+    return NULL;
+
+  /* The rating only depends on what the solver forces before it first has to
+   * branch, and on whether it has to, so one node is enough to rate the board
+   * and keeps this quick whatever the size */
+  tilepaint_solver_count(puzzle, TILEPAINT_SOLVER_PROPAGATE, 1, NULL, NULL,
+                         &check);
+  tilepaint_solver_stats_add(&stats->solver, &check);
+  puzzle->difficulty =
+      tilepaint_difficulty_from_stats(&check, puzzle->num_tiles);
+
+  return puzzle;
 }
 
-static int count_solutions(TilepaintApplication *tilepaint, int num_tiles) {
-  SolverCtx ctx;
-  ctx.size = tilepaint->board_size;
-  ctx.num_tiles = num_tiles;
-  ctx.row_clues = tilepaint->row_clues;
-  ctx.col_clues = tilepaint->col_clues;
-  ctx.solutions_found = 0;
+/* Makes an ambiguous board unique by merging tiles rather than starting
+ * again. A second solution, the witness, differs from the intended one by
+ * swapping some tiles' colours without changing any clue. Merging two
+ * neighbouring tiles of the same intended colour but different witness
+ * colours rules the witness out and keeps the intended solution, and the
+ * clues, as they are. Each uniqueness check runs as a TilepaintSolver, so a
+ * repair can be carried on a slice at a time. */
+typedef struct {
+  TilepaintPuzzle *puzzle;
+  GRand *rng;
+  guint max_cells;
+  guint edit;             /* merges made so far */
+  TilepaintSolver *check; /* the uniqueness check in progress */
+  guchar *witness;
+  guint *tile_cells;
+  guint *merges; /* pairs of neighbouring cells */
+} Repair;
+
+static void repair_init(Repair *repair, TilepaintPuzzle *puzzle, GRand *rng,
+                        guint max_cells) {
+  guint n_cells = puzzle->size * puzzle->size;
+
+  repair->puzzle = puzzle;
+  repair->rng = rng;
+  repair->max_cells = max_cells;
+  repair->edit = 0;
+  repair->check = tilepaint_solver_new_witness(puzzle, SOLVER_NODE_BUDGET);
+  repair->witness = g_new(guchar, n_cells);
+  repair->tile_cells = g_new(guint, n_cells);
+  repair->merges = g_new(guint, 4 * n_cells);
+}
 
-  ctx.tile_row_map = g_new0(int *, num_tiles);
-  ctx.tile_col_map = g_new0(int *, num_tiles);
-  for (int i = 0; i < num_tiles; i++) {
-    ctx.tile_row_map[i] = g_new0(int, ctx.size);
-    ctx.tile_col_map[i] = g_new0(int, ctx.size);
+/* Adds the work of a check cut short, if any, to stats */
+static void repair_clear(Repair *repair, TilepaintGeneratorStats *stats) {
+  if (repair->check != NULL) {
+    tilepaint_solver_get_stats(repair->check, &stats->solver);
+    tilepaint_solver_free(repair->check);
   }
 
-  ctx.current_row_sums = g_new0(int, ctx.size);
-  ctx.current_col_sums = g_new0(int, ctx.size);
-  ctx.remaining_row_tiles_sum = g_new0(int, ctx.size);
-  ctx.remaining_col_tiles_sum = g_new0(int, ctx.size);
+  g_free(repair->witness);
+  g_free(repair->tile_cells);
+  g_free(repair->merges);
+}
+
+/* Merges a random pair of tiles that rules out the witness. Returns FALSE if
+ * there is no such pair. */
+static gboolean repair_merge(Repair *repair) {
+  TilepaintPuzzle *puzzle = repair->puzzle;
+  guint size = puzzle->size;
+  guint n_cells = size * size;
+  guint *tile_cells = repair->tile_cells;
+  guint *merges = repair->merges;
+  guint n_merges = 0;
+  guint i, keep, drop;
+
+  memset(tile_cells, 0, n_cells * sizeof(guint));
+  for (i = 0; i < n_cells; i++)
+    tile_cells[puzzle->tile_ids[i]]++;
+
+  for (i = 0; i < n_cells; i++) {
+    /* The neighbours below and to the right */
+    guint neighbours[2] = {i + size, i + 1};
 
-  /* Populate maps */
-  for (guint x = 0; x < ctx.size; x++) {
-    for (guint y = 0; y < ctx.size; y++) {
-      int tid = tilepaint->board[x][y].tile_id;
-      ctx.tile_row_map[tid][y]++;
-      ctx.tile_col_map[tid][x]++;
-      ctx.remaining_row_tiles_sum[y]++;
-      ctx.remaining_col_tiles_sum[x]++;
+    for (guint n = 0; n < G_N_ELEMENTS(neighbours); n++) {
+      guint j = neighbours[n];
+      guint a, b;
+
+      if (j >= n_cells || (n == 1 && j % size == 0))
+        continue;
+
+      a = puzzle->tile_ids[i];
+      b = puzzle->tile_ids[j];
+      if (a != b && puzzle->solution[i] == puzzle->solution[j] &&
+          repair->witness[i] != repair->witness[j] &&
+          tile_cells[a] + tile_cells[b] <= repair->max_cells) {
+        merges[2 * n_merges] = i;
+        merges[2 * n_merges + 1] = j;
+        n_merges++;
+      }
     }
   }
 
-  solve_recursive(&ctx, 0);
+  if (n_merges == 0)
+    return FALSE;
 
-  /* Cleanup */
-  for (int i = 0; i < num_tiles; i++) {
-    g_free(ctx.tile_row_map[i]);
-    g_free(ctx.tile_col_map[i]);
+  i = g_rand_int_range(repair->rng, 0, n_merges);
+  keep = puzzle->tile_ids[merges[2 * i]];
+  drop = puzzle->tile_ids[merges[2 * i + 1]];
+  for (i = 0; i < n_cells; i++) {
+    if (puzzle->tile_ids[i] == drop)
+      puzzle->tile_ids[i] = keep;
   }
-  g_free(ctx.tile_row_map);
-  g_free(ctx.tile_col_map);
-  g_free(ctx.current_row_sums);
-  g_free(ctx.current_col_sums);
-  g_free(ctx.remaining_row_tiles_sum);
-  g_free(ctx.remaining_col_tiles_sum);
+  renumber_tiles(puzzle);
 
-  return ctx.solutions_found;
+  return TRUE;
 }
 
-void tilepaint_generate_board(TilepaintApplication *tilepaint,
-                              guint new_board_size, guint seed) {
-  guint x, y;
+/* Carries the repair on for up to `budget` solver nodes. Returns TRUE once it
+ * is over, with unique set to whether the board ended up unique. */
+static gboolean repair_step(Repair *repair, guint budget,
+                            TilepaintGeneratorStats *stats,
+                            gboolean *unique) {
+  TilepaintSolverStats check = {0};
+  gboolean found;
+  guint n_solutions;
 
-  g_return_if_fail(tilepaint != NULL);
-  g_return_if_fail(new_board_size > 0);
+  if (!tilepaint_solver_step(repair->check, budget))
+    return FALSE;
 
-  /* Seed the random number generator */
-  if (seed == 0)
-    seed = g_get_real_time();
+  found = tilepaint_solver_get_witness(repair->check, repair->witness);
+  n_solutions = tilepaint_solver_get_n_solutions(repair->check);
+  tilepaint_solver_get_stats(repair->check, &check);
+  tilepaint_solver_stats_add(&stats->solver, &check);
+  tilepaint_solver_free(repair->check);
+  repair->check = NULL;
 
-  if (tilepaint->debug)
-    g_debug("Seed value: %u", seed);
+  if (!found) {
+    /* No other solution, unless the solver gave up before finding one. The
+     * check has then solved the board in full, which rates it for free. */
+    *unique = n_solutions == 1;
+    if (*unique)
+      repair->puzzle->difficulty =
+          tilepaint_difficulty_from_stats(&check, repair->puzzle->num_tiles);
+    return TRUE;
+  }
 
-  srand(seed);
+  /* Each merge rules out at least the witness */
+  if (repair->edit == REPAIR_MAX_EDITS || !repair_merge(repair)) {
+    *unique = FALSE;
+    return TRUE;
+  }
 
-  int attempts = 0;
-  while (TRUE) {
-    attempts++;
+  repair->edit++;
+  stats->repairs++;
+  repair->check =
+      tilepaint_solver_new_witness(repair->puzzle, SOLVER_NODE_BUDGET);
+
+  return FALSE;
+}
 
-    /* Deallocate any previous board */
-    tilepaint_free_board(tilepaint);
+/* Repairs the board in one go. Returns whether it ends up unique. */
+static gboolean repair_board(TilepaintPuzzle *puzzle, GRand *rng,
+                             guint max_cells,
+                             TilepaintSolverAbortFunc should_abort,
+                             gpointer abort_data,
+                             TilepaintGeneratorStats *stats) {
+  Repair repair;
+  gboolean unique = FALSE;
 
-    tilepaint->board_size = new_board_size;
+  repair_init(&repair, puzzle, rng, max_cells);
 
-    /* Allocate the board */
-    tilepaint->board = g_new(TilepaintCell *, tilepaint->board_size);
-    for (x = 0; x < tilepaint->board_size; x++)
-      tilepaint->board[x] =
-          g_slice_alloc0(sizeof(TilepaintCell) * tilepaint->board_size);
+  while (!repair_step(&repair, REPAIR_STEP_NODES, stats, &unique)) {
+    if (should_abort != NULL && should_abort(abort_data))
+      break;
+  }
 
-    /* 1. Generate Solution */
-    gboolean *solution_data =
-        g_new(gboolean, tilepaint->board_size * tilepaint->board_size);
-    gboolean **solution = g_new(gboolean *, tilepaint->board_size);
-    for (x = 0; x < tilepaint->board_size; x++)
-      solution[x] = solution_data + (x * tilepaint->board_size);
+  repair_clear(&repair, stats);
+
+  return unique;
+}
 
-    for (x = 0; x < tilepaint->board_size; x++) {
-      for (y = 0; y < tilepaint->board_size; y++) {
-        solution[x][y] = rand() % 2; /* 50% chance */
+/* Every attempt draws from its own random stream, so the outcome depends only
+ * on (seed, attempt) and not on which thread runs it or in what order */
+static GRand *candidate_rng(guint seed, guint attempt) {
+  guint32 seed_array[2] = {seed, attempt};
+
+  return g_rand_new_with_seed_array(seed_array, G_N_ELEMENTS(seed_array));
+}
+
+/* Tiles may grow to this many cells */
+static guint candidate_max_cells(guint size) {
+  return size > CLASSIC_MAX_SIZE ? size / 2 : size * size;
+}
+
+/* Builds a candidate board into `puzzle`, which may well be ambiguous */
+static void build_candidate(TilepaintPuzzle *puzzle, GRand *rng,
+                            TilepaintGeneratorStats *stats) {
+  guint size = puzzle->size;
+  gboolean any_colour = size > CLASSIC_MAX_SIZE;
+  guint max_cells = candidate_max_cells(size);
+  gint64 phase_start = g_get_monotonic_time(), now;
+  guint x, y;
+
+  stats->attempts++;
+  puzzle->difficulty = TILEPAINT_DIFFICULTY_ANY;
+
+  /* 1. Generate Solution */
+  for (x = 0; x < size * size; x++)
+    puzzle->solution[x] = g_rand_boolean(rng); /* 50% chance */
+
+  now = g_get_monotonic_time();
+  stats->fill_time += now - phase_start;
+  phase_start = now;
+
+  /* 2. Partition into Tiles, straight into the puzzle */
+  Point *queue = g_new(Point, size * size);
+  guint16 current_tile_id = 0;
+
+  for (x = 0; x < size * size; x++)
+    puzzle->tile_ids[x] = NO_TILE;
+
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      if (puzzle->tile_ids[x * size + y] == NO_TILE) {
+        puzzle->tile_ids[x * size + y] = current_tile_id;
+        grow_tile(rng, puzzle->tile_ids, puzzle->solution, queue, size, x, y,
+                  current_tile_id, any_colour, max_cells);
+        current_tile_id++;
       }
     }
+  }
 
-    /* 2. Partition into Tiles */
-    gint *tile_ids_data =
-        g_new(gint, tilepaint->board_size * tilepaint->board_size);
-    gint **tile_ids = g_new(gint *, tilepaint->board_size);
-    for (x = 0; x < tilepaint->board_size; x++)
-      tile_ids[x] = tile_ids_data + (x * tilepaint->board_size);
-
-    for (x = 0; x < tilepaint->board_size * tilepaint->board_size; x++)
-      tile_ids_data[x] = -1;
-
-    int current_tile_id = 0;
-
-    for (x = 0; x < tilepaint->board_size; x++) {
-      for (y = 0; y < tilepaint->board_size; y++) {
-        if (tile_ids[x][y] == -1) {
-          tile_ids[x][y] = current_tile_id;
-          grow_tile(tile_ids, solution, tilepaint->board_size, x, y,
-                    current_tile_id);
-          current_tile_id++;
-        }
-      }
+  g_free(queue);
+
+  /* Tiles grown across colours take the colour of the cell they started
+   * from, which is the first cell of the tile in this order */
+  if (any_colour) {
+    guchar *tile_colours = g_new(guchar, current_tile_id);
+    guint16 n_seen = 0;
+
+    for (x = 0; x < size * size; x++) {
+      guint16 tile = puzzle->tile_ids[x];
+
+      if (tile == n_seen)
+        tile_colours[n_seen++] = puzzle->solution[x];
+      puzzle->solution[x] = tile_colours[tile];
     }
 
-    /* 3. Store to app (temporary for rules check) */
-    for (x = 0; x < tilepaint->board_size; x++) {
-      for (y = 0; y < tilepaint->board_size; y++) {
-        tilepaint->board[x][y].tile_id = tile_ids[x][y];
-        if (solution[x][y])
-          tilepaint->board[x][y].status = CELL_SHOULD_BE_PAINTED;
-        else
-          tilepaint->board[x][y].status = 0;
-      }
+    g_free(tile_colours);
+  }
+
+  puzzle->num_tiles = current_tile_id;
+
+  now = g_get_monotonic_time();
+  stats->partition_time += now - phase_start;
+  phase_start = now;
+
+  /* 3. Calculate Clues */
+  memset(puzzle->row_clues, 0, size);
+  memset(puzzle->col_clues, 0, size);
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      puzzle->row_clues[y] += puzzle->solution[x * size + y];
+      puzzle->col_clues[x] += puzzle->solution[x * size + y];
     }
+  }
+
+  stats->clue_time += g_get_monotonic_time() - phase_start;
+}
+
+/* Whether a repaired candidate will do: it must be unique and, for the first
+ * DIFFICULTY_MAX_ATTEMPTS attempts, of the requested difficulty */
+static gboolean candidate_accepted(const TilepaintPuzzle *puzzle,
+                                   guint attempt,
+                                   TilepaintDifficulty difficulty,
+                                   gboolean unique,
+                                   TilepaintGeneratorStats *stats) {
+  if (unique && difficulty != TILEPAINT_DIFFICULTY_ANY &&
+      puzzle->difficulty != difficulty && attempt < DIFFICULTY_MAX_ATTEMPTS) {
+    stats->off_target++;
+    return FALSE;
+  }
+
+  return unique;
+}
+
+/* Builds candidate board number `attempt` for `seed` into `puzzle`, repairs
+ * it if it is ambiguous, and returns whether it is accepted */
+static gboolean generate_attempt(TilepaintPuzzle *puzzle, guint seed,
+                                 guint attempt, TilepaintDifficulty difficulty,
+                                 TilepaintSolverAbortFunc should_abort,
+                                 gpointer abort_data,
+                                 TilepaintGeneratorStats *stats) {
+  GRand *rng = candidate_rng(seed, attempt);
+  gboolean unique;
+  gint64 start;
+
+  build_candidate(puzzle, rng, stats);
+
+  start = g_get_monotonic_time();
+  unique = repair_board(puzzle, rng, candidate_max_cells(puzzle->size),
+                        should_abort, abort_data, stats);
+  g_rand_free(rng);
+  stats->unique_time += g_get_monotonic_time() - start;
+
+  return candidate_accepted(puzzle, attempt, difficulty, unique, stats);
+}
+
+/* When a generation has to stop: once cancelled, or at the deadline if it
+ * isn't 0 */
+typedef struct {
+  GCancellable *cancellable;
+  gint64 deadline;
+} GenerateLimits;
+
+static gboolean limits_timed_out(const GenerateLimits *limits) {
+  return limits->deadline != 0 && g_get_monotonic_time() >= limits->deadline;
+}
+
+static gboolean limits_should_abort(gpointer user_data) {
+  const GenerateLimits *limits = user_data;
+
+  return g_cancellable_is_cancelled(limits->cancellable) ||
+         limits_timed_out(limits);
+}
+
+static gint64 limits_deadline(gint64 time_budget) {
+  return time_budget > 0 ? g_get_monotonic_time() + time_budget : 0;
+}
+
+/* State shared by the threads of a parallel generation. Attempts are handed
+ * out in increasing order and the lowest-numbered unique one wins, which is
+ * exactly the board the serial loop would have returned. */
+typedef struct {
+  guint size;
+  guint seed;
+  TilepaintDifficulty difficulty;
+  GenerateLimits limits;
 
-    /* 4. Calculate Clues */
-    for (y = 0; y < tilepaint->board_size; y++) {
-      int count = 0;
-      for (x = 0; x < tilepaint->board_size; x++) {
-        if (solution[x][y])
-          count++;
+  gint next_attempt; /* atomic */
+  gint winner;       /* atomic; G_MAXINT until an attempt succeeds */
+
+  GMutex lock;
+  TilepaintPuzzle *puzzle;       /* protected by lock */
+  TilepaintGeneratorStats stats; /* protected by lock */
+  gint unfinished; /* protected by lock; lowest attempt a thread stopped on */
+} GenerateRace;
+
+typedef struct {
+  GenerateRace *race;
+  gint attempt;
+} RaceCandidate;
+
+/* Once a lower attempt has won, nothing this candidate finds can be used */
+static gboolean race_should_abort(gpointer user_data) {
+  RaceCandidate *candidate = user_data;
+
+  return g_atomic_int_get(&candidate->race->winner) < candidate->attempt ||
+         limits_should_abort(&candidate->race->limits);
+}
+
+static void race_worker(gpointer data, gpointer user_data) {
+  GenerateRace *race = user_data;
+  TilepaintPuzzle *puzzle = tilepaint_puzzle_new(race->size);
+  RaceCandidate candidate = {race, 0};
+  TilepaintGeneratorStats stats = {0};
+
+  while (TRUE) {
+    candidate.attempt = g_atomic_int_add(&race->next_attempt, 1);
+
+    if (race_should_abort(&candidate))
+      break;
+
+    if (generate_attempt(puzzle, race->seed, candidate.attempt,
+                         race->difficulty, race_should_abort, &candidate, &stats)) {
+      g_mutex_lock(&race->lock);
+      if (candidate.attempt < g_atomic_int_get(&race->winner)) {
+        tilepaint_puzzle_free(race->puzzle);
+        race->puzzle = puzzle;
+        puzzle = NULL;
+        g_atomic_int_set(&race->winner, candidate.attempt);
       }
-      tilepaint->row_clues[y] = count;
+      g_mutex_unlock(&race->lock);
+
+      /* Any attempt handed out from now on is higher than ours */
+      break;
     }
+  }
 
-    for (x = 0; x < tilepaint->board_size; x++) {
-      int count = 0;
-      for (y = 0; y < tilepaint->board_size; y++) {
-        if (solution[x][y])
-          count++;
-      }
-      tilepaint->col_clues[x] = count;
+  g_mutex_lock(&race->lock);
+  tilepaint_generator_stats_add(&race->stats, &stats);
+  race->unfinished = MIN(race->unfinished, candidate.attempt);
+  g_mutex_unlock(&race->lock);
+
+  tilepaint_puzzle_free(puzzle);
+}
+
+/* Tries attempts from *attempt on. Returns NULL if cancelled or, if deadline
+ * isn't 0, once it is reached, with *attempt set to the first attempt that
+ * wasn't finished. */
+static TilepaintPuzzle *generate_parallel(guint size, guint seed,
+                                          TilepaintDifficulty difficulty,
+                                          guint n_threads, gint64 deadline,
+                                          GCancellable *cancellable,
+                                          guint *attempt,
+                                          TilepaintGeneratorStats *stats) {
+  GenerateRace race;
+  GThreadPool *pool;
+  GError *error = NULL;
+  guint i;
+
+  race.size = size;
+  race.seed = seed;
+  race.difficulty = difficulty;
+  race.limits.cancellable = cancellable;
+  race.limits.deadline = deadline;
+  race.next_attempt = *attempt;
+  race.winner = G_MAXINT;
+  race.puzzle = NULL;
+  race.unfinished = G_MAXINT;
+  memset(&race.stats, 0, sizeof(race.stats));
+  g_mutex_init(&race.lock);
+
+  pool = g_thread_pool_new(race_worker, &race, n_threads, FALSE, &error);
+  if (pool == NULL) {
+    g_warning("Failed to start generator threads: %s", error->message);
+    g_error_free(error);
+    g_mutex_clear(&race.lock);
+    return NULL;
+  }
+
+  /* Each task keeps taking attempts until one of them wins */
+  for (i = 0; i < n_threads; i++)
+    g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+
+  g_thread_pool_free(pool, FALSE, TRUE);
+  g_mutex_clear(&race.lock);
+
+  tilepaint_generator_stats_add(stats, &race.stats);
+
+  if (race.puzzle != NULL)
+    g_debug("Found unique board in %d attempts on %u threads", race.winner + 1,
+            n_threads);
+  else
+    *attempt = race.unfinished;
+
+  return race.puzzle;
+}
+
+/* As generate_parallel(), on the calling thread */
+static TilepaintPuzzle *generate_serial(guint size, guint seed,
+                                        TilepaintDifficulty difficulty,
+                                        gint64 deadline,
+                                        GCancellable *cancellable,
+                                        guint *attempt,
+                                        TilepaintGeneratorStats *stats) {
+  TilepaintPuzzle *puzzle = tilepaint_puzzle_new(size);
+  GenerateLimits limits = {cancellable, deadline};
+  gboolean limited = cancellable != NULL || deadline != 0;
+
+  for (;; (*attempt)++) {
+    if (generate_attempt(puzzle, seed, *attempt, difficulty,
+                         limited ? limits_should_abort : NULL, &limits,
+                         stats)) {
+      g_debug("Found unique board in %u attempts", *attempt + 1);
+      return puzzle;
+    }
+
+    if (limits_should_abort(&limits)) {
+      g_debug("Board generation stopped after %u attempts", *attempt + 1);
+      tilepaint_puzzle_free(puzzle);
+      return NULL;
     }
+  }
+}
+
+TilepaintPuzzle *
+tilepaint_puzzle_generate(guint size, const TilepaintGeneratorOptions *options,
+                          GCancellable *cancellable) {
+  TilepaintGeneratorStats stats = {0};
+  TilepaintPuzzle *puzzle;
+  guint seed = 0;
+  guint n_threads = 1;
+  TilepaintDifficulty difficulty = TILEPAINT_DIFFICULTY_ANY;
+  gint64 deadline = 0;
+  TilepaintGeneratorFallbackFunc fallback = NULL;
+  gpointer fallback_data = NULL;
+  guint attempt = 0;
 
-    /* 5. Check Uniqueness */
-    int sol_count = count_solutions(tilepaint, current_tile_id);
+  g_return_val_if_fail(size > 0 && size <= TILEPAINT_PUZZLE_MAX_SIZE, NULL);
 
-    /* Cleanup temporary structures */
-    g_free(solution);
-    g_free(solution_data);
-    g_free(tile_ids);
-    g_free(tile_ids_data);
+  if (options != NULL) {
+    seed = options->seed;
+    n_threads = MAX(options->n_threads, 1);
+    difficulty = options->difficulty;
+    deadline = limits_deadline(options->time_budget);
+    fallback = options->fallback;
+    fallback_data = options->fallback_data;
+  }
 
-    if (sol_count == 1) {
-      if (tilepaint->debug)
-        g_debug("Found unique board in %d attempts", attempts);
+  /* Seed the random number generator */
+  if (seed == 0)
+    seed = g_get_real_time();
+
+  g_debug("Seed value: %u", seed);
+
+  while (TRUE) {
+    if (n_threads > 1)
+      puzzle = generate_parallel(size, seed, difficulty, n_threads, deadline,
+                                 cancellable, &attempt, &stats);
+    else
+      puzzle = generate_serial(size, seed, difficulty, deadline, cancellable,
+                               &attempt, &stats);
+
+    if (puzzle != NULL) {
+      remember_board(puzzle);
       break;
     }
-  }
 
-  /* Clear cell statuses for the player (except secret goal) */
-  for (x = 0; x < tilepaint->board_size; x++) {
-    for (y = 0; y < tilepaint->board_size; y++) {
-      gboolean should_be =
-          (tilepaint->board[x][y].status & CELL_SHOULD_BE_PAINTED) != 0;
-      tilepaint->board[x][y].status = should_be ? CELL_SHOULD_BE_PAINTED : 0;
+    if (g_cancellable_is_cancelled(cancellable)) {
+      g_debug("Board generation cancelled");
+      break;
     }
+
+    /* Out of time, so fall back on a ready-made or earlier board or, if
+     * there is none, carry on from the attempt that was cut short and take
+     * the first unique board of any difficulty. Each attempt is bounded by
+     * SOLVER_NODE_BUDGET and REPAIR_MAX_EDITS, so that's quick. */
+    g_debug("Board generation ran out of time");
+    stats.fallbacks++;
+    puzzle = fallback_board(size, seed, fallback, fallback_data, &stats);
+    if (puzzle != NULL)
+      break;
+
+    difficulty = TILEPAINT_DIFFICULTY_ANY;
+    deadline = 0;
+  }
+
+  if (puzzle != NULL)
+    stats.boards++;
+  if (options != NULL && options->stats != NULL)
+    tilepaint_generator_stats_add(options->stats, &stats);
+
+  return puzzle;
+}
+
+/* A generation run a slice at a time. Candidates are tried in the same order
+ * as tilepaint_puzzle_generate() tries them on one thread, so the same seed
+ * gives the same board. */
+struct _TilepaintGenerator {
+  guint seed;
+  TilepaintDifficulty difficulty;
+  TilepaintGeneratorStats stats;
+  TilepaintGeneratorStats *stats_out; /* added to once finished or freed */
+
+  TilepaintPuzzle *puzzle;
+  gint64 deadline; /* 0 for none, or once it has passed */
+  TilepaintGeneratorFallbackFunc fallback;
+  gpointer fallback_data;
+  guint attempt;
+  GRand *rng;    /* the candidate's, or NULL between candidates */
+  Repair repair; /* of the candidate, while rng is set */
+  gboolean finished;
+};
+
+/* Sets up a generation that is run by calling tilepaint_generator_step()
+ * until it finishes, and that can be dropped at any point between steps.
+ * options->n_threads is ignored; the stats, if any, must outlive it. */
+TilepaintGenerator *
+tilepaint_generator_new(guint size, const TilepaintGeneratorOptions *options) {
+  TilepaintGenerator *generator;
+
+  g_return_val_if_fail(size > 0 && size <= TILEPAINT_PUZZLE_MAX_SIZE, NULL);
+
+  generator = g_new0(TilepaintGenerator, 1);
+  generator->puzzle = tilepaint_puzzle_new(size);
+
+  if (options != NULL) {
+    generator->seed = options->seed;
+    generator->difficulty = options->difficulty;
+    generator->stats_out = options->stats;
+    generator->deadline = limits_deadline(options->time_budget);
+    generator->fallback = options->fallback;
+    generator->fallback_data = options->fallback_data;
+  }
+
+  if (generator->seed == 0)
+    generator->seed = g_get_real_time();
+
+  g_debug("Seed value: %u", generator->seed);
+
+  return generator;
+}
+
+void tilepaint_generator_free(TilepaintGenerator *generator) {
+  if (generator == NULL)
+    return;
+
+  if (generator->rng != NULL) {
+    repair_clear(&generator->repair, &generator->stats);
+    g_rand_free(generator->rng);
   }
 
-  /* Update things */
-  tilepaint_enable_events(tilepaint);
+  if (!generator->finished && generator->stats_out != NULL)
+    tilepaint_generator_stats_add(generator->stats_out, &generator->stats);
+
+  tilepaint_puzzle_free(generator->puzzle);
+  g_free(generator);
+}
+
+static void generator_finish(TilepaintGenerator *generator) {
+  generator->finished = TRUE;
+  generator->stats.boards++;
+  if (generator->stats_out != NULL)
+    tilepaint_generator_stats_add(generator->stats_out, &generator->stats);
+}
+
+/* Falls back as tilepaint_puzzle_generate() does once out of time, carrying
+ * on from the attempt in progress if there's no board to fall back on.
+ * Returns TRUE if that finished the generation. */
+static gboolean generator_time_out(TilepaintGenerator *generator) {
+  TilepaintPuzzle *fallback;
+
+  g_debug("Board generation ran out of time");
+  generator->stats.fallbacks++;
+  generator->deadline = 0;
+
+  if (generator->rng != NULL) {
+    repair_clear(&generator->repair, &generator->stats);
+    g_rand_free(generator->rng);
+    generator->rng = NULL;
+  }
+
+  fallback = fallback_board(generator->puzzle->size, generator->seed,
+                            generator->fallback, generator->fallback_data,
+                            &generator->stats);
+  if (fallback == NULL) {
+    generator->difficulty = TILEPAINT_DIFFICULTY_ANY;
+    return FALSE;
+  }
+
+  tilepaint_puzzle_free(generator->puzzle);
+  generator->puzzle = fallback;
+  generator_finish(generator);
+
+  return TRUE;
+}
+
+/* Carries generation on for up to `budget` solver nodes, plus building at
+ * most one candidate. Returns TRUE once a board is ready. */
+gboolean tilepaint_generator_step(TilepaintGenerator *generator,
+                                  guint budget) {
+  gboolean unique;
+  gint64 start;
+
+  g_return_val_if_fail(generator != NULL, TRUE);
+
+  if (generator->finished)
+    return TRUE;
+
+  if (generator->deadline != 0 &&
+      g_get_monotonic_time() >= generator->deadline &&
+      generator_time_out(generator))
+    return TRUE;
+
+  if (generator->rng == NULL) {
+    generator->rng = candidate_rng(generator->seed, generator->attempt);
+    build_candidate(generator->puzzle, generator->rng, &generator->stats);
+    repair_init(&generator->repair, generator->puzzle, generator->rng,
+                candidate_max_cells(generator->puzzle->size));
+  }
+
+  start = g_get_monotonic_time();
+  if (!repair_step(&generator->repair, budget, &generator->stats, &unique)) {
+    generator->stats.unique_time += g_get_monotonic_time() - start;
+    return FALSE;
+  }
+  generator->stats.unique_time += g_get_monotonic_time() - start;
+
+  repair_clear(&generator->repair, &generator->stats);
+  g_rand_free(generator->rng);
+  generator->rng = NULL;
+
+  if (!candidate_accepted(generator->puzzle, generator->attempt,
+                          generator->difficulty, unique, &generator->stats)) {
+    generator->attempt++;
+    return FALSE;
+  }
+
+  g_debug("Found unique board in %u attempts", generator->attempt + 1);
+  remember_board(generator->puzzle);
+  generator_finish(generator);
+
+  return TRUE;
+}
+
+/* Takes the board of a finished generation */
+TilepaintPuzzle *tilepaint_generator_steal_puzzle(TilepaintGenerator *generator) {
+  TilepaintPuzzle *puzzle;
+
+  g_return_val_if_fail(generator != NULL, NULL);
+  g_return_val_if_fail(generator->finished, NULL);
+
+  puzzle = generator->puzzle;
+  generator->puzzle = NULL;
+
+  return puzzle;
+}
+
+/* How long each run of the idle source may take, so that input is never held
+ * up by more than about a frame, and how many solver nodes it visits between
+ * looking at the clock */
+#define IDLE_SLICE_USEC 4000
+#define IDLE_STEP_NODES 64
+
+static gboolean generate_idle_cb(gpointer user_data) {
+  GTask *task = user_data;
+  TilepaintGenerator *generator = g_task_get_task_data(task);
+  TilepaintPuzzle *puzzle;
+  gint64 deadline = g_get_monotonic_time() + IDLE_SLICE_USEC;
+
+  if (g_task_return_error_if_cancelled(task)) {
+    /* Frees the generator now, which adds its stats */
+    g_task_set_task_data(task, NULL, NULL);
+    return G_SOURCE_REMOVE;
+  }
+
+  while (!tilepaint_generator_step(generator, IDLE_STEP_NODES)) {
+    if (g_get_monotonic_time() >= deadline)
+      return G_SOURCE_CONTINUE;
+  }
+
+  puzzle = tilepaint_generator_steal_puzzle(generator);
+  g_task_set_task_data(task, NULL, NULL);
+  g_task_return_pointer(task, puzzle, (GDestroyNotify)tilepaint_puzzle_free);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Generates a board on the thread-default main context, a slice at a time
+ * from an idle source, so that the context keeps handling input meanwhile.
+ * The board is the same as tilepaint_puzzle_generate() gives on one thread.
+ * options->stats, if set, is added to before the callback is called. */
+void tilepaint_puzzle_generate_idle_async(
+    guint size, const TilepaintGeneratorOptions *options,
+    GCancellable *cancellable, GAsyncReadyCallback callback,
+    gpointer user_data) {
+  GTask *task;
+  GSource *source;
+
+  g_return_if_fail(size > 0 && size <= TILEPAINT_PUZZLE_MAX_SIZE);
+
+  task = g_task_new(NULL, cancellable, callback, user_data);
+  g_task_set_source_tag(task, tilepaint_puzzle_generate_idle_async);
+  g_task_set_task_data(task, tilepaint_generator_new(size, options),
+                       (GDestroyNotify)tilepaint_generator_free);
+
+  /* g_task_attach_source() gives the source the task's priority. An idle
+   * source is always ready, so at the default priority it would hold off
+   * redrawing, and with it any spinner, until the board is done. */
+  g_task_set_priority(task, G_PRIORITY_DEFAULT_IDLE);
+
+  source = g_idle_source_new();
+  g_task_attach_source(task, source, generate_idle_cb);
+  g_source_unref(source);
+  g_object_unref(task);
+}
+
+/* Returns the board, or NULL with error set if the generation was
+ * cancelled */
+TilepaintPuzzle *tilepaint_puzzle_generate_idle_finish(GAsyncResult *result,
+                                                       GError **error) {
+  g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+  g_return_val_if_fail(g_async_result_is_tagged(
+                           result, tilepaint_puzzle_generate_idle_async),
+                       NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/* Names of the difficulties, as used by the settings and tilepaint-gen */
+static const gchar *const difficulty_names[] = {"any", "easy", "medium",
+                                                "hard"};
+
+/* Rates a board from the stats of the propagating engine solving it in full.
+ * A board it had to branch on is hard. Otherwise it is easy if fewer than
+ * half its tiles had to be worked out by weighing a line's tiles against the
+ * clue, rather than read off a line that is to be left empty or filled. */
+TilepaintDifficulty
+tilepaint_difficulty_from_stats(const TilepaintSolverStats *stats,
+                                guint num_tiles) {
+  g_return_val_if_fail(stats != NULL, TILEPAINT_DIFFICULTY_ANY);
+
+  if (stats->nodes > 1)
+    return TILEPAINT_DIFFICULTY_HARD;
+  if (stats->subset_deductions * 2 < num_tiles)
+    return TILEPAINT_DIFFICULTY_EASY;
+
+  return TILEPAINT_DIFFICULTY_MEDIUM;
+}
+
+const gchar *tilepaint_difficulty_to_string(TilepaintDifficulty difficulty) {
+  g_return_val_if_fail(difficulty < G_N_ELEMENTS(difficulty_names), NULL);
+
+  return difficulty_names[difficulty];
+}
+
+/* Returns TILEPAINT_DIFFICULTY_ANY for names it doesn't know */
+TilepaintDifficulty tilepaint_difficulty_from_string(const gchar *name) {
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS(difficulty_names); i++) {
+    if (g_strcmp0(name, difficulty_names[i]) == 0)
+      return i;
+  }
+
+  return TILEPAINT_DIFFICULTY_ANY;
+}
+
+void tilepaint_generator_stats_add(TilepaintGeneratorStats *stats,
+                                   const TilepaintGeneratorStats *other) {
+  stats->boards += other->boards;
+  stats->attempts += other->attempts;
+  stats->repairs += other->repairs;
+  stats->off_target += other->off_target;
+  stats->fallbacks += other->fallbacks;
+  tilepaint_solver_stats_add(&stats->solver, &other->solver);
+  stats->fill_time += other->fill_time;
+  stats->partition_time += other->partition_time;
+  stats->clue_time += other->clue_time;
+  stats->unique_time += other->unique_time;
+}
+
+/* Formats the stats, for boards of the given size, as a one-line JSON
+ * object */
+gchar *tilepaint_generator_stats_to_json(const TilepaintGeneratorStats *stats,
+                                         guint size) {
+  return g_strdup_printf(
+      "{\"size\": %u, \"boards\": %" G_GUINT64_FORMAT
+      ", \"attempts\": %" G_GUINT64_FORMAT ", \"repairs\": %" G_GUINT64_FORMAT
+      ", \"off_target\": %" G_GUINT64_FORMAT
+      ", \"fallbacks\": %" G_GUINT64_FORMAT
+      ", \"solver\": {\"nodes\": %" G_GUINT64_FORMAT
+      ", \"memo_hits\": %" G_GUINT64_FORMAT
+      ", \"overshoot_prunes\": %" G_GUINT64_FORMAT
+      ", \"shortfall_prunes\": %" G_GUINT64_FORMAT
+      ", \"subset_deductions\": %" G_GUINT64_FORMAT ", \"max_depth\": %u}"
+      ", \"time_us\": {\"fill\": %" G_GINT64_FORMAT
+      ", \"partition\": %" G_GINT64_FORMAT ", \"clues\": %" G_GINT64_FORMAT
+      ", \"uniqueness\": %" G_GINT64_FORMAT "}}",
+      size, stats->boards, stats->attempts, stats->repairs, stats->off_target,
+      stats->fallbacks, stats->solver.nodes, stats->solver.memo_hits,
+      stats->solver.overshoot_prunes, stats->solver.shortfall_prunes,
+      stats->solver.subset_deductions, stats->solver.max_depth,
+      stats->fill_time, stats->partition_time, stats->clue_time,
+      stats->unique_time);
 }
@@ -17,15 +17,127 @@
  * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <gio/gio.h>
 #include <glib.h>
 
 #ifndef TILEPAINT_GENERATOR_H
 #define TILEPAINT_GENERATOR_H
 
 G_BEGIN_DECLS
-typedef struct _TilepaintApplication Tilepaint;
 
-void tilepaint_generate_board(Tilepaint *tilepaint, guint new_board_size, guint seed);
+/* Largest board the generator can build, bounded by the solver's lane width */
+#define TILEPAINT_PUZZLE_MAX_SIZE 30
+
+/* How much work a board takes to solve by logic, as rated by the generator
+ * from the solver's final uniqueness check. The values are stored in puzzle
+ * packs, so they mustn't change. */
+typedef enum {
+  TILEPAINT_DIFFICULTY_ANY = 0, /* unrated, or no preference */
+  TILEPAINT_DIFFICULTY_EASY,    /* forced line by line, mostly at a glance */
+  TILEPAINT_DIFFICULTY_MEDIUM,  /* forced, but often by weighing tiles */
+  TILEPAINT_DIFFICULTY_HARD,    /* needs trial and error */
+} TilepaintDifficulty;
+
+/* A generated board with a unique solution, independent of the application.
+ * Cell arrays are size * size long and indexed as [x * size + y]. */
+typedef struct {
+  guint size;
+  guint num_tiles;
+  TilepaintDifficulty difficulty;
+  guint16 *tile_ids;
+  guchar *solution; /* non-zero where the cell should be painted */
+  guchar *row_clues;
+  guchar *col_clues;
+} TilepaintPuzzle;
+
+/* Work done by the solver (see solver.h). A branch is pruned by overshooting
+ * if painting a tile would exceed a clue, and by falling short if leaving it
+ * empty would leave too few cells to meet one. */
+typedef struct {
+  guint64 nodes;            /* search nodes visited */
+  guint64 memo_hits;        /* subtrees whose count was already known */
+  guint64 overshoot_prunes; /* branches ruled out by overshooting */
+  guint64 shortfall_prunes; /* branches ruled out by falling short */
+  /* Tiles the propagating engine forced from a line that was neither to be
+   * left empty nor painted in full, so that working them out means weighing
+   * the line's tiles against its clue */
+  guint64 subset_deductions;
+  guint max_depth; /* deepest branching */
+} TilepaintSolverStats;
+
+/* Work done by the generator, added to by each board. Times are wall-clock
+ * microseconds summed over every attempt, on whichever thread ran it. */
+typedef struct {
+  guint64 boards;
+  guint64 attempts;   /* candidate boards built */
+  guint64 repairs;    /* tiles merged to make candidates unique */
+  guint64 off_target; /* unique candidates outside the requested difficulty */
+  guint64 fallbacks;  /* boards given after the time budget ran out */
+  TilepaintSolverStats solver;
+
+  gint64 fill_time;      /* choosing the solution */
+  gint64 partition_time; /* growing the tiles */
+  gint64 clue_time;      /* counting the clues */
+  gint64 unique_time;    /* checking and repairing uniqueness */
+} TilepaintGeneratorStats;
+
+/* Returns a ready-made unique board of the given size and any difficulty, or
+ * NULL if there is none. It may be called from any thread. */
+typedef TilepaintPuzzle *(*TilepaintGeneratorFallbackFunc)(guint size,
+                                                           gpointer user_data);
+
+typedef struct {
+  guint seed;      /* 0 to seed from the clock */
+  guint n_threads; /* candidates searched in parallel; 0 or 1 for serial */
+  TilepaintGeneratorStats *stats; /* added to if not NULL */
+  /* Candidates of any other difficulty are passed over, for up to
+   * DIFFICULTY_MAX_ATTEMPTS attempts (see generator.c) */
+  TilepaintDifficulty difficulty;
+  /* Microseconds of wall-clock time to spend before falling back on a
+   * ready-made or earlier board, or on any difficulty; 0 for no limit */
+  gint64 time_budget;
+  /* Tried first once out of time, if not NULL */
+  TilepaintGeneratorFallbackFunc fallback;
+  gpointer fallback_data;
+} TilepaintGeneratorOptions;
+
+TilepaintPuzzle *tilepaint_puzzle_new(guint size);
+TilepaintPuzzle *
+tilepaint_puzzle_generate(guint size, const TilepaintGeneratorOptions *options,
+                          GCancellable *cancellable);
+void tilepaint_puzzle_free(TilepaintPuzzle *puzzle);
+TilepaintPuzzle *tilepaint_puzzle_transform(const TilepaintPuzzle *puzzle,
+                                            guint transform);
+guint64 tilepaint_puzzle_fingerprint(const TilepaintPuzzle *puzzle);
+
+void tilepaint_puzzle_generate_idle_async(
+    guint size, const TilepaintGeneratorOptions *options,
+    GCancellable *cancellable, GAsyncReadyCallback callback,
+    gpointer user_data);
+TilepaintPuzzle *tilepaint_puzzle_generate_idle_finish(GAsyncResult *result,
+                                                       GError **error);
+
+/* A generation that runs a slice at a time (see tilepaint_generator_step()) */
+typedef struct _TilepaintGenerator TilepaintGenerator;
+
+TilepaintGenerator *
+tilepaint_generator_new(guint size, const TilepaintGeneratorOptions *options);
+void tilepaint_generator_free(TilepaintGenerator *generator);
+gboolean tilepaint_generator_step(TilepaintGenerator *generator,
+                                  guint budget);
+TilepaintPuzzle *
+tilepaint_generator_steal_puzzle(TilepaintGenerator *generator);
+
+TilepaintDifficulty
+tilepaint_difficulty_from_stats(const TilepaintSolverStats *stats,
+                                guint num_tiles);
+const gchar *tilepaint_difficulty_to_string(TilepaintDifficulty difficulty);
+TilepaintDifficulty tilepaint_difficulty_from_string(const gchar *name);
+
+void tilepaint_generator_stats_add(TilepaintGeneratorStats *stats,
+                                   const TilepaintGeneratorStats *other);
+gchar *tilepaint_generator_stats_to_json(const TilepaintGeneratorStats *stats,
+                                         guint size);
 
 G_END_DECLS
 
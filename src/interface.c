@@ -36,6 +36,7 @@
 #define HINT_DISABLED 0
 #define HINT_INTERVAL 500
 #define CURSOR_MARGIN 3
+#define CLUE_GAP 0.25 /* between the clues and the grid, in cells */
 
 static void tilepaint_cancel_hinting(TilepaintApplication *tilepaint);
 static void board_theme_change_cb(GSettings *settings, const gchar *key,
@@ -85,8 +86,12 @@ GdkRGBA tilepaint_clue_color(TilepaintApplication *tilepaint, int count,
 /* Declarations for GtkBuilder */
 void tilepaint_draw_cb(GtkDrawingArea *drawing_area, cairo_t *cr, int width,
                        int height, gpointer user_data);
-static void tilepaint_click_released_cb(GtkGestureClick *gesture, int n_press,
-                                        double x, double y, gpointer user_data);
+static void tilepaint_drag_begin_cb(GtkGestureDrag *gesture, double x,
+                                    double y, gpointer user_data);
+static void tilepaint_drag_update_cb(GtkGestureDrag *gesture, double offset_x,
+                                     double offset_y, gpointer user_data);
+static void tilepaint_drag_end_cb(GtkGestureDrag *gesture, double offset_x,
+                                  double offset_y, gpointer user_data);
 static gboolean tilepaint_key_pressed_cb(GtkEventControllerKey *controller,
                                          guint keyval, guint keycode,
                                          GdkModifierType state,
@@ -117,6 +122,10 @@ static void board_theme_cb(GSimpleAction *action, GVariant *parameter,
                            gpointer user_data);
 static void board_size_change_cb(GSettings *settings, const gchar *key,
                                  gpointer user_data);
+static void difficulty_cb(GSimpleAction *action, GVariant *parameter,
+                          gpointer user_data);
+static void difficulty_change_cb(GSettings *settings, const gchar *key,
+                                 gpointer user_data);
 static void style_manager_dark_changed_cb(AdwStyleManager *style_manager,
                                           GParamSpec *pspec,
                                           gpointer user_data);
@@ -136,6 +145,7 @@ static GActionEntry app_entries[] = {
     {"help", help_cb, NULL, NULL, NULL},
     {"quit", quit_cb, NULL, NULL, NULL},
     {"board-size", board_size_cb, "s", "'5'", NULL},
+    {"difficulty", difficulty_cb, "s", "'any'", NULL},
     {"board-theme", board_theme_cb, "s", "'tilepaint'", NULL},
     {"preferences", preferences_cb, NULL, NULL, NULL},
 };
@@ -172,7 +182,7 @@ static void win_dialog_response_cb(AdwAlertDialog *dialog, const char *response,
   if (g_strcmp0(response, "quit") == 0) {
     tilepaint_quit(tilepaint);
   } else if (g_strcmp0(response, "play-again") == 0) {
-    tilepaint_new_game(tilepaint, tilepaint->board_size);
+    tilepaint_new_game(tilepaint, tilepaint->requested_board_size);
   }
 }
 
@@ -536,6 +546,8 @@ GtkWidget *tilepaint_create_interface(TilepaintApplication *tilepaint) {
 
   g_signal_connect(tilepaint->settings, "changed::board-size",
                    G_CALLBACK(board_size_change_cb), tilepaint);
+  g_signal_connect(tilepaint->settings, "changed::difficulty",
+                   G_CALLBACK(difficulty_change_cb), tilepaint);
   g_signal_connect(tilepaint->settings, "changed::board-theme",
                    G_CALLBACK(board_theme_change_cb), tilepaint);
   g_signal_connect(tilepaint->settings, "changed::clue-color-feedback",
@@ -577,6 +589,11 @@ GtkWidget *tilepaint_create_interface(TilepaintApplication *tilepaint) {
   g_simple_action_set_state(G_SIMPLE_ACTION(action), state);
   g_variant_unref(state);
 
+  action = g_action_map_lookup_action(G_ACTION_MAP(tilepaint), "difficulty");
+  state = g_settings_get_value(tilepaint->settings, "difficulty");
+  g_simple_action_set_state(G_SIMPLE_ACTION(action), state);
+  g_variant_unref(state);
+
   action = g_action_map_lookup_action(G_ACTION_MAP(tilepaint), "board-theme");
   state = g_settings_get_value(tilepaint->settings, "board-theme");
   g_simple_action_set_state(G_SIMPLE_ACTION(action), state);
@@ -655,14 +672,19 @@ GtkWidget *tilepaint_create_interface(TilepaintApplication *tilepaint) {
   gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(tilepaint->drawing_area),
                                  tilepaint_draw_cb, tilepaint, NULL);
 
-  /* Set up mouse input */
-  GtkGesture *click_gesture = gtk_gesture_click_new();
-  gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(click_gesture),
+  /* Set up mouse input: a click toggles a cell, and a drag every cell it
+   * crosses */
+  GtkGesture *drag_gesture = gtk_gesture_drag_new();
+  gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(drag_gesture),
                                 GDK_BUTTON_PRIMARY);
-  g_signal_connect(click_gesture, "released",
-                   G_CALLBACK(tilepaint_click_released_cb), tilepaint);
+  g_signal_connect(drag_gesture, "drag-begin",
+                   G_CALLBACK(tilepaint_drag_begin_cb), tilepaint);
+  g_signal_connect(drag_gesture, "drag-update",
+                   G_CALLBACK(tilepaint_drag_update_cb), tilepaint);
+  g_signal_connect(drag_gesture, "drag-end", G_CALLBACK(tilepaint_drag_end_cb),
+                   tilepaint);
   gtk_widget_add_controller(tilepaint->drawing_area,
-                            GTK_EVENT_CONTROLLER(click_gesture));
+                            GTK_EVENT_CONTROLLER(drag_gesture));
 
   /* Set up keyboard input */
   GtkEventController *key_controller = gtk_event_controller_key_new();
@@ -684,7 +706,7 @@ static void draw_cell_background(TilepaintApplication *tilepaint, cairo_t *cr,
   gboolean painted = FALSE;
   GdkRGBA colour = {0.0, 0.0, 0.0, 1.0};
 
-  if (tilepaint->board[iter.x][iter.y].status & CELL_PAINTED) {
+  if (tilepaint_cell(tilepaint, iter.x, iter.y)->status & CELL_PAINTED) {
     painted = TRUE;
   }
 
@@ -700,7 +722,7 @@ static void draw_cell_background(TilepaintApplication *tilepaint, cairo_t *cr,
   cairo_fill(cr);
 
   /* Draw Tags */
-  if (tilepaint->board[iter.x][iter.y].status & CELL_TAG1) {
+  if (tilepaint_cell(tilepaint, iter.x, iter.y)->status & CELL_TAG1) {
     colour = (GdkRGBA){0.447, 0.624, 0.812, painted ? 0.7 : 1.0};
     gdk_cairo_set_source_rgba(cr, &colour);
     cairo_arc(cr, x_pos + cell_size / 2, y_pos + cell_size / 2, cell_size / 8,
@@ -715,7 +737,7 @@ static void draw_cell_overlays(TilepaintApplication *tilepaint, cairo_t *cr,
   GdkRGBA colour;
 
   /* Error handling */
-  if (tilepaint->board[iter.x][iter.y].status & CELL_ERROR) {
+  if (tilepaint_cell(tilepaint, iter.x, iter.y)->status & CELL_ERROR) {
     colour = tilepaint->theme->error_text;
     gdk_cairo_set_source_rgba(cr, &colour);
     cairo_set_line_width(cr, BORDER_LEFT);
@@ -740,10 +762,64 @@ static void draw_cell_overlays(TilepaintApplication *tilepaint, cairo_t *cr,
   }
 }
 
+/* A quarter circle going round a faint full one, in place of the board */
+static void draw_busy(TilepaintApplication *tilepaint, cairo_t *cr, int width,
+                      int height) {
+  GdkRGBA colour = tilepaint->theme->painted_bg;
+  gdouble radius = MIN(width, height) / 16.0;
+  gdouble angle = (gdouble)(g_get_monotonic_time() % G_USEC_PER_SEC) /
+                  G_USEC_PER_SEC * 2 * M_PI;
+
+  cairo_set_line_width(cr, radius / 4);
+  cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+
+  colour.alpha = 0.25;
+  gdk_cairo_set_source_rgba(cr, &colour);
+  cairo_arc(cr, width / 2.0, height / 2.0, radius, 0, 2 * M_PI);
+  cairo_stroke(cr);
+
+  colour.alpha = 1.0;
+  gdk_cairo_set_source_rgba(cr, &colour);
+  cairo_arc(cr, width / 2.0, height / 2.0, radius, angle, angle + M_PI / 2);
+  cairo_stroke(cr);
+}
+
+static gboolean busy_tick_cb(GtkWidget *widget, GdkFrameClock *frame_clock,
+                             gpointer user_data) {
+  gtk_widget_queue_draw(widget);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* Shows the busy state instead of the board, animated once a frame, while the
+ * next board is built */
+void tilepaint_set_busy(TilepaintApplication *tilepaint, gboolean busy) {
+  if (tilepaint->is_busy == busy)
+    return;
+
+  tilepaint->is_busy = busy;
+
+  if (busy) {
+    tilepaint->busy_tick_id = gtk_widget_add_tick_callback(
+        tilepaint->drawing_area, busy_tick_cb, NULL, NULL);
+  } else {
+    gtk_widget_remove_tick_callback(tilepaint->drawing_area,
+                                    tilepaint->busy_tick_id);
+    tilepaint->busy_tick_id = 0;
+  }
+
+  gtk_widget_queue_draw(tilepaint->drawing_area);
+}
+
 void tilepaint_draw_cb(GtkDrawingArea *drawing_area, cairo_t *cr, int width,
                        int height, gpointer user_data) {
   TilepaintApplication *tilepaint = (TilepaintApplication *)user_data;
 
+  if (tilepaint->is_busy || tilepaint->board == NULL) {
+    draw_busy(tilepaint, cr, width, height);
+    return;
+  }
+
   if (tilepaint->is_paused) {
     /* When paused, we might hide the board or similar, but for now just draw
      * normally but maybe overlay is handled by separate widget */
@@ -758,7 +834,7 @@ void tilepaint_draw_cb(GtkDrawingArea *drawing_area, cairo_t *cr, int width,
   gint area_width = width;
   gint area_height = height;
   TilepaintVector iter;
-  gdouble gap_factor = 0.25;
+  gdouble gap_factor = CLUE_GAP;
   gdouble board_display_size = tilepaint->board_size + 1 + gap_factor;
   gdouble cell_size;
 
@@ -825,13 +901,7 @@ void tilepaint_draw_cb(GtkDrawingArea *drawing_area, cairo_t *cr, int width,
 
     /* Draw Text */
     if (!tilepaint->is_paused) {
-      int __count = 0;
-      if (tilepaint->board) {
-        for (int __yy = 0; __yy < tilepaint->board_size; __yy++) {
-          if (tilepaint->board[x][__yy].status & CELL_PAINTED)
-            __count++;
-        }
-      }
+      int __count = tilepaint->col_counts[x];
       GdkRGBA text_col;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Waggregate-return"
@@ -888,13 +958,7 @@ void tilepaint_draw_cb(GtkDrawingArea *drawing_area, cairo_t *cr, int width,
 
     /* Draw Text */
     if (!tilepaint->is_paused) {
-      int __count = 0;
-      if (tilepaint->board) {
-        for (int __xx = 0; __xx < tilepaint->board_size; __xx++) {
-          if (tilepaint->board[__xx][y].status & CELL_PAINTED)
-            __count++;
-        }
-      }
+      int __count = tilepaint->row_counts[y];
       GdkRGBA text_col;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Waggregate-return"
@@ -990,82 +1054,98 @@ void tilepaint_draw_cb(GtkDrawingArea *drawing_area, cairo_t *cr, int width,
   }
 }
 
-static void tilepaint_update_cell_state(TilepaintApplication *tilepaint,
-                                        TilepaintVector pos, gboolean tag1,
-                                        gboolean tag2) {
-  TilepaintUndo *undo;
-  gboolean recheck = FALSE;
-
-  /* Update the undo stack */
-  undo = g_new(TilepaintUndo, 1);
-  undo->cell = pos;
-  undo->undo = tilepaint->undo_stack;
-  undo->redo = NULL;
-
-  /* Tilepaint Logic: If clicking a cell, we toggle the WHOLE tile */
-  /* Unless tagging, which might be per-cell?
-     Let's keep tagging per-cell for user notes, but painting is per-tile. */
-
-  if (tag1 && tag2) {
-    /* Update both tags' state */
-    tilepaint->board[pos.x][pos.y].status ^= CELL_TAG1;
-    tilepaint->board[pos.x][pos.y].status ^= CELL_TAG2;
-    undo->type = UNDO_TAGS;
-  } else if (tag1) {
-    /* Update tag 1's state */
-    tilepaint->board[pos.x][pos.y].status ^= CELL_TAG1;
-    undo->type = UNDO_TAG1;
-  } else if (tag2) {
-    /* Update tag 2's state */
-    tilepaint->board[pos.x][pos.y].status ^= CELL_TAG2;
-    undo->type = UNDO_TAG2;
-  } else {
-    /* Update the paint status for the individual cell */
-    tilepaint->board[pos.x][pos.y].status ^= CELL_PAINTED;
-    undo->type = UNDO_PAINT;
-
-    recheck = TRUE;
+/* The cell flags which a move of the given type toggles, and which undoing
+ * or redoing it toggles back */
+static guchar undo_type_flags(TilepaintUndoType type) {
+  switch (type) {
+  case UNDO_PAINT:
+    return CELL_PAINTED;
+  case UNDO_TAG1:
+    return CELL_TAG1;
+  case UNDO_TAG2:
+    return CELL_TAG2;
+  case UNDO_TAGS:
+    return CELL_TAG1 | CELL_TAG2;
+  case UNDO_TILE_PAINT:
+  default:
+    /* This is just here to stop the compiler warning */
+    g_assert_not_reached();
+    return 0;
   }
+}
 
-  tilepaint->made_a_move = TRUE;
+/* Redraws the board and, if any paint changed, checks to see if the player's
+ * won: once a frame, however many cells a drag crossed since the last */
+static gboolean update_tick_cb(GtkWidget *widget, GdkFrameClock *frame_clock,
+                               gpointer user_data) {
+  TilepaintApplication *tilepaint = (TilepaintApplication *)user_data;
+  gboolean recheck = tilepaint->update_recheck;
 
-  if (tilepaint->undo_stack != NULL) {
-    TilepaintUndo *i, *next = NULL;
+  tilepaint->update_tick_id = 0;
+  tilepaint->update_recheck = FALSE;
 
-    /* Free the redo stack after this point. */
-    for (i = tilepaint->undo_stack->redo; i != NULL; i = next) {
-      next = i->redo;
-      g_free(i);
-    }
+  /* Redraw */
+  gtk_widget_queue_draw(widget);
 
-    tilepaint->undo_stack->redo = undo;
-  }
-  tilepaint->undo_stack = undo;
+  /* A new board may have been started since */
+  if (recheck && tilepaint->processing_events)
+    tilepaint_check_win(tilepaint);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void queue_update(TilepaintApplication *tilepaint, gboolean recheck) {
+  tilepaint->update_recheck |= recheck;
+
+  if (tilepaint->update_tick_id == 0)
+    tilepaint->update_tick_id = gtk_widget_add_tick_callback(
+        tilepaint->drawing_area, update_tick_cb, tilepaint, NULL);
+}
+
+/* The move a click or drag makes with the given modifiers */
+static TilepaintUndoType move_type(gboolean tag1, gboolean tag2) {
+  /* Tagging is per-cell for user notes, as is painting */
+  if (tag1 && tag2)
+    return UNDO_TAGS;
+  else if (tag1)
+    return UNDO_TAG1;
+  else if (tag2)
+    return UNDO_TAG2;
+  else
+    return UNDO_PAINT;
+}
+
+/* Toggles a cell. A joined move is undone and redone along with the one
+ * before it. */
+static void make_move(TilepaintApplication *tilepaint, TilepaintVector pos,
+                      TilepaintUndoType type, gboolean joined) {
+  tilepaint_toggle_cell(tilepaint, pos.x, pos.y, undo_type_flags(type));
+  tilepaint->made_a_move = TRUE;
+
+  /* Update the undo history, which forgets any undone moves */
+  tilepaint_undo_history_push(tilepaint->undo_history, type, pos.x, pos.y,
+                              joined);
   g_simple_action_set_enabled(tilepaint->undo_action, TRUE);
   g_simple_action_set_enabled(tilepaint->redo_action, FALSE);
 
   /* Stop any current hints */
   tilepaint_cancel_hinting(tilepaint);
 
-  /* Redraw */
-  gtk_widget_queue_draw(tilepaint->drawing_area);
+  queue_update(tilepaint, type == UNDO_PAINT);
+}
 
-  /* Check to see if the player's won */
-  if (recheck == TRUE)
-    tilepaint_check_win(tilepaint);
+static void tilepaint_update_cell_state(TilepaintApplication *tilepaint,
+                                        TilepaintVector pos, gboolean tag1,
+                                        gboolean tag2) {
+  make_move(tilepaint, pos, move_type(tag1, tag2), FALSE);
 }
 
-static void tilepaint_click_released_cb(GtkGestureClick *gesture, int n_press,
-                                        double x, double y,
-                                        gpointer user_data) {
-  TilepaintApplication *tilepaint = (TilepaintApplication *)user_data;
+/* Finds the cell drawn at a point of the drawing area, laid out as
+ * tilepaint_draw_cb() lays it out. Returns FALSE if there isn't one. */
+static gboolean cell_at_point(TilepaintApplication *tilepaint, gdouble x,
+                              gdouble y, TilepaintVector *pos) {
   gint width, height;
   gdouble cell_size;
-  TilepaintVector pos;
-  GdkModifierType state;
-
-  if (tilepaint->processing_events == FALSE)
-    return;
 
   width = gtk_widget_get_width(tilepaint->drawing_area);
   height = gtk_widget_get_height(tilepaint->drawing_area);
@@ -1074,29 +1154,55 @@ static void tilepaint_click_released_cb(GtkGestureClick *gesture, int n_press,
   gdouble board_pixel_size = (height < width) ? height : width;
   board_pixel_size -= BORDER_LEFT;
 
-  guint board_display_size = tilepaint->board_size + 1; /* +1 for headers */
-  cell_size = (gdouble)board_pixel_size / (gdouble)board_display_size;
-
-  /* Calculate relative position on board, accounting for offsets and headers */
-  /* Headers take up 1 cell size at top and left */
-  /* Grid starts at offset + cell_size */
+  /* +1 for headers, and the gap between them and the grid */
+  gdouble board_display_size = tilepaint->board_size + 1 + CLUE_GAP;
+  cell_size = board_pixel_size / board_display_size;
 
-  double grid_start_x = tilepaint->drawing_area_x_offset + cell_size;
-  double grid_start_y = tilepaint->drawing_area_y_offset + cell_size;
+  /* Grid starts at offset + header + gap */
+  double grid_start_x =
+      tilepaint->drawing_area_x_offset + (1 + CLUE_GAP) * cell_size;
+  double grid_start_y =
+      tilepaint->drawing_area_y_offset + (1 + CLUE_GAP) * cell_size;
 
   if (x < grid_start_x || y < grid_start_y)
-    return; /* Clicked in header or margin */
+    return FALSE; /* In header or margin */
 
-  /* Determine the cell in which the button was released */
   int cx = (int)((x - grid_start_x) / cell_size);
   int cy = (int)((y - grid_start_y) / cell_size);
 
-  if (cx < 0 || cy < 0 || cx >= tilepaint->board_size ||
-      cy >= tilepaint->board_size)
+  if (cx >= tilepaint->board_size || cy >= tilepaint->board_size)
+    return FALSE;
+
+  pos->x = (guchar)cx;
+  pos->y = (guchar)cy;
+
+  return TRUE;
+}
+
+/* Carries the stroke on to a cell it has reached, which is toggled if it is
+ * as the stroke's first cell was before the stroke toggled it */
+static void stroke_cell(TilepaintApplication *tilepaint, TilepaintVector pos) {
+  guchar flags = undo_type_flags(tilepaint->stroke_type);
+
+  if (pos.x >= tilepaint->board_size || pos.y >= tilepaint->board_size)
     return;
 
-  pos.x = (guchar)cx;
-  pos.y = (guchar)cy;
+  if ((tilepaint_cell(tilepaint, pos.x, pos.y)->status & flags) ==
+      tilepaint->stroke_from)
+    make_move(tilepaint, pos, tilepaint->stroke_type, TRUE);
+}
+
+static void tilepaint_drag_begin_cb(GtkGestureDrag *gesture, double x,
+                                    double y, gpointer user_data) {
+  TilepaintApplication *tilepaint = (TilepaintApplication *)user_data;
+  TilepaintVector pos;
+  GdkModifierType state;
+
+  tilepaint->stroke_active = FALSE;
+
+  if (tilepaint->processing_events == FALSE ||
+      !cell_at_point(tilepaint, x, y, &pos))
+    return;
 
   /* Move the cursor to the clicked cell and deactivate it
    * (assuming player will use the mouse for the next move) */
@@ -1110,8 +1216,70 @@ static void tilepaint_click_released_cb(GtkGestureClick *gesture, int n_press,
   state = gtk_event_controller_get_current_event_state(
       GTK_EVENT_CONTROLLER(gesture));
 
-  tilepaint_update_cell_state(tilepaint, pos, state & GDK_SHIFT_MASK,
-                              state & GDK_CONTROL_MASK);
+  /* The whole stroke paints, unpaints or tags as its first cell does */
+  tilepaint->stroke_active = TRUE;
+  tilepaint->stroke_type =
+      move_type(state & GDK_SHIFT_MASK, state & GDK_CONTROL_MASK);
+  tilepaint->stroke_from = tilepaint_cell(tilepaint, pos.x, pos.y)->status &
+                           undo_type_flags(tilepaint->stroke_type);
+  tilepaint->stroke_last = pos;
+
+  make_move(tilepaint, pos, tilepaint->stroke_type, FALSE);
+}
+
+static void tilepaint_drag_update_cb(GtkGestureDrag *gesture, double offset_x,
+                                     double offset_y, gpointer user_data) {
+  TilepaintApplication *tilepaint = (TilepaintApplication *)user_data;
+  TilepaintVector pos;
+  gdouble start_x, start_y;
+  gint x0, y0, dx, dy, step_x, step_y, error;
+
+  /* The stroke ends early if the player's won */
+  if (!tilepaint->stroke_active || tilepaint->processing_events == FALSE)
+    return;
+
+  /* Nor may it walk in from outside the board, should the board change */
+  if (tilepaint->stroke_last.x >= tilepaint->board_size ||
+      tilepaint->stroke_last.y >= tilepaint->board_size) {
+    tilepaint->stroke_active = FALSE;
+    return;
+  }
+
+  gtk_gesture_drag_get_start_point(gesture, &start_x, &start_y);
+  if (!cell_at_point(tilepaint, start_x + offset_x, start_y + offset_y, &pos))
+    return;
+
+  /* Walk a line of cells from the last one reached, so that none is missed
+   * if the pointer moved more than a cell between events */
+  x0 = tilepaint->stroke_last.x;
+  y0 = tilepaint->stroke_last.y;
+  dx = ABS(pos.x - x0);
+  dy = -ABS(pos.y - y0);
+  step_x = x0 < pos.x ? 1 : -1;
+  step_y = y0 < pos.y ? 1 : -1;
+  error = dx + dy;
+
+  while (x0 != pos.x || y0 != pos.y) {
+    if (2 * error >= dy) {
+      error += dy;
+      x0 += step_x;
+    } else {
+      error += dx;
+      y0 += step_y;
+    }
+
+    stroke_cell(tilepaint, (TilepaintVector){x0, y0});
+  }
+
+  tilepaint->stroke_last = pos;
+  tilepaint->cursor_position = pos;
+}
+
+static void tilepaint_drag_end_cb(GtkGestureDrag *gesture, double offset_x,
+                                  double offset_y, gpointer user_data) {
+  TilepaintApplication *tilepaint = (TilepaintApplication *)user_data;
+
+  tilepaint->stroke_active = FALSE;
 }
 
 static gboolean tilepaint_key_pressed_cb(GtkEventControllerKey *controller,
@@ -1197,7 +1365,7 @@ static void quit_cb(GSimpleAction *action, GVariant *parameters,
 static void new_game_cb(GSimpleAction *action, GVariant *parameters,
                         gpointer user_data) {
   TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
-  tilepaint_new_game(self, self->board_size);
+  tilepaint_new_game(self, self->requested_board_size);
 }
 
 static void tilepaint_cancel_hinting(TilepaintApplication *tilepaint) {
@@ -1244,23 +1412,23 @@ static void hint_cb(GSimpleAction *action, GVariant *parameter,
 
   /* Find the first cell which should be painted, but isn't (or vice-versa) */
   for (iter.x = 0; iter.x < self->board_size; iter.x++) {
-    for (iter.y = 0; iter.y < self->board_size; iter.y++) {
-      guchar status = self->board[iter.x][iter.y].status &
-                      (CELL_PAINTED | CELL_SHOULD_BE_PAINTED);
-
-      if (status <= MAX(CELL_SHOULD_BE_PAINTED, CELL_PAINTED) && status > 0) {
-        if (self->debug)
-          g_debug("Beginning hinting in cell (%u,%u).", iter.x, iter.y);
-
-        /* Set up the cell for hinting */
-        self->hint_status = HINT_FLASHES;
-        self->hint_position = iter;
-        self->hint_timeout_id = g_timeout_add(
-            HINT_INTERVAL, (GSourceFunc)tilepaint_update_hint, self);
-        tilepaint_update_hint((gpointer)self);
-
-        return;
-      }
+    guint32 wrong =
+        self->painted.cols[iter.x] ^ self->should_be_painted.cols[iter.x];
+
+    if (wrong != 0) {
+      iter.y = __builtin_ctz(wrong);
+
+      if (self->debug)
+        g_debug("Beginning hinting in cell (%u,%u).", iter.x, iter.y);
+
+      /* Set up the cell for hinting */
+      self->hint_status = HINT_FLASHES;
+      self->hint_position = iter;
+      self->hint_timeout_id = g_timeout_add(
+          HINT_INTERVAL, (GSourceFunc)tilepaint_update_hint, self);
+      tilepaint_update_hint((gpointer)self);
+
+      return;
     }
   }
 }
@@ -1268,99 +1436,52 @@ static void hint_cb(GSimpleAction *action, GVariant *parameter,
 static void undo_cb(GSimpleAction *action, GVariant *parameter,
                     gpointer user_data) {
   TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
+  const TilepaintUndoRecord *record;
 
-  if (self->undo_stack->undo == NULL)
+  if (!tilepaint_undo_history_can_undo(self->undo_history))
     return;
 
-  switch (self->undo_stack->type) {
-  case UNDO_PAINT:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_PAINTED;
-    break;
-  case UNDO_TAG1:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG1;
-    break;
-  case UNDO_TAG2:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG2;
-    break;
-  case UNDO_TAGS:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG1;
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG2;
-    break;
-  case UNDO_NEW_GAME:
-  case UNDO_TILE_PAINT:
-  default:
-    /* This is just here to stop the compiler warning */
-    g_assert_not_reached();
-    break;
-  }
-
-  self->cursor_position = self->undo_stack->cell;
-  self->undo_stack = self->undo_stack->undo;
+  /* Undo the whole drag, back to the move it started with */
+  do {
+    record = tilepaint_undo_history_undo(self->undo_history);
+    tilepaint_toggle_cell(self, record->x, record->y,
+                          undo_type_flags(record->type));
+  } while (record->joined &&
+           tilepaint_undo_history_can_undo(self->undo_history));
+  self->cursor_position = (TilepaintVector){record->x, record->y};
 
   g_simple_action_set_enabled(self->redo_action, TRUE);
-  if (self->undo_stack->undo == NULL || self->undo_stack->type == UNDO_NEW_GAME)
+  if (!tilepaint_undo_history_can_undo(self->undo_history))
     g_simple_action_set_enabled(self->undo_action, FALSE);
 
   /* The player can't possibly have won, but we need to update the error
    * highlighting */
-  tilepaint_check_win(self);
-
-  /* Redraw */
-  gtk_widget_queue_draw(self->drawing_area);
+  queue_update(self, TRUE);
 }
 
 static void redo_cb(GSimpleAction *action, GVariant *parameter,
                     gpointer user_data) {
   TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
+  const TilepaintUndoRecord *record;
 
-  if (self->undo_stack->redo == NULL)
+  if (!tilepaint_undo_history_can_redo(self->undo_history))
     return;
 
-  self->undo_stack = self->undo_stack->redo;
-  self->cursor_position = self->undo_stack->cell;
-
-  switch (self->undo_stack->type) {
-  case UNDO_PAINT:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_PAINTED;
-    break;
-  case UNDO_TAG1:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG1;
-    break;
-  case UNDO_TAG2:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG2;
-    break;
-  case UNDO_TAGS:
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG1;
-    self->board[self->undo_stack->cell.x][self->undo_stack->cell.y].status ^=
-        CELL_TAG2;
-    break;
-  case UNDO_NEW_GAME:
-  case UNDO_TILE_PAINT:
-  default:
-    /* This is just here to stop the compiler warning */
-    g_assert_not_reached();
-    break;
-  }
+  /* Redo the whole drag, up to the end of it */
+  do {
+    record = tilepaint_undo_history_redo(self->undo_history);
+    tilepaint_toggle_cell(self, record->x, record->y,
+                          undo_type_flags(record->type));
+  } while (tilepaint_undo_history_redo_is_joined(self->undo_history));
+  self->cursor_position = (TilepaintVector){record->x, record->y};
 
   g_simple_action_set_enabled(self->undo_action, TRUE);
-  if (self->undo_stack->redo == NULL)
+  if (!tilepaint_undo_history_can_redo(self->undo_history))
     g_simple_action_set_enabled(self->redo_action, FALSE);
 
   /* The player can't possibly have won, but we need to update the error
    * highlighting */
-  tilepaint_check_win(self);
-
-  /* Redraw */
-  gtk_widget_queue_draw(self->drawing_area);
+  queue_update(self, TRUE);
 }
 
 static void pause_cb(GSimpleAction *action, GVariant *parameter,
@@ -1622,19 +1743,37 @@ static void board_size_change_cb(GSettings *settings, const gchar *key,
   size = g_ascii_strtoull(size_str, NULL, 10);
   g_free(size_str);
 
-  if (size > MAX_BOARD_SIZE) {
+  if (size < MIN_BOARD_SIZE || size > MAX_BOARD_SIZE) {
     GVariant *default_size =
         g_settings_get_default_value(self->settings, "board-size");
     g_variant_get(default_size, "s", &size_str);
     g_variant_unref(default_size);
     size = g_ascii_strtoull(size_str, NULL, 10);
     g_free(size_str);
-    g_assert(size <= MAX_BOARD_SIZE);
+    g_assert(size >= MIN_BOARD_SIZE && size <= MAX_BOARD_SIZE);
   }
 
   tilepaint_set_board_size(self, size);
 }
 
+static void difficulty_cb(GSimpleAction *action, GVariant *parameter,
+                          gpointer user_data) {
+  TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
+  g_settings_set_value(self->settings, "difficulty", parameter);
+  g_simple_action_set_state(action, parameter);
+}
+
+/* Takes effect from the next new game, so as not to throw away this one */
+static void difficulty_change_cb(GSettings *settings, const gchar *key,
+                                 gpointer user_data) {
+  TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
+  gchar *difficulty_str;
+
+  difficulty_str = g_settings_get_string(self->settings, "difficulty");
+  self->difficulty = tilepaint_difficulty_from_string(difficulty_str);
+  g_free(difficulty_str);
+}
+
 static void board_theme_change_cb(GSettings *settings, const gchar *key,
                                   gpointer user_data) {
   TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
@@ -27,6 +27,7 @@
 G_BEGIN_DECLS
 
 GtkWidget* tilepaint_create_interface (Tilepaint *tilepaint);
+void tilepaint_set_busy(Tilepaint *tilepaint, gboolean busy);
 
 GdkRGBA tilepaint_clue_color(TilepaintApplication *tilepaint, int count,
                              int clue, gboolean feedback);
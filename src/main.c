@@ -24,10 +24,12 @@
 #include <gtk/gtk.h>
 #include <locale.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "generator.h"
 #include "interface.h"
 #include "main.h"
+#include "rules.h"
 
 static void constructed(GObject *object);
 static void get_property(GObject *object, guint property_id, GValue *value,
@@ -42,19 +44,54 @@ typedef struct {
   /* Command line parameters. */
   gboolean debug;
   guint seed;
+  gint threads;
+  gchar *pack_path;
 } TilepaintApplicationPrivate;
 
 typedef enum { PROP_DEBUG = 1, PROP_SEED } TilepaintProperty;
 
+/* Number of boards kept ready for the size being played */
+#define PREFETCH_DEPTH 2
+
+/* Boards this size and up are generated on every core when the player is
+ * waiting for them */
+#define PARALLEL_MIN_BOARD_SIZE 8
+
+G_STATIC_ASSERT(MAX_BOARD_SIZE <= TILEPAINT_PUZZLE_MAX_SIZE);
+
 G_DEFINE_TYPE_WITH_PRIVATE(TilepaintApplication, tilepaint_application,
                            GTK_TYPE_APPLICATION)
 
+/* Held while generate_fallback_cb() reads the puzzle pack and the prefetched
+ * boards, which may be on a generator thread, and while they are freed */
+G_LOCK_DEFINE_STATIC(fallback_sources);
+
+/* Stops building the board asked for last, if it's still being built */
+static void cancel_generation(Tilepaint *tilepaint) {
+  if (tilepaint->generate_cancellable != NULL) {
+    g_cancellable_cancel(tilepaint->generate_cancellable);
+    g_clear_object(&tilepaint->generate_cancellable);
+  }
+}
+
+static void start_game(Tilepaint *tilepaint, guint board_size, guint seed);
+
 static void shutdown(GApplication *application) {
   TilepaintApplication *self = TILEPAINT_APPLICATION(application);
 
+  /* Stop background generation before tearing anything else down. A board
+   * being generated on a thread may still fall back on these until then. */
+  cancel_generation(self);
+  G_LOCK(fallback_sources);
+  if (self->prefetch != NULL) {
+    tilepaint_prefetch_free(self->prefetch);
+    self->prefetch = NULL;
+  }
+  g_clear_pointer(&self->pack, tilepaint_pack_free);
+  G_UNLOCK(fallback_sources);
+
   tilepaint_free_board(self);
-  tilepaint_clear_undo_stack(self);
-  g_free(self->undo_stack); /* Clear the new game element */
+  g_clear_pointer(&self->undo_history, tilepaint_undo_history_free);
 
   /* Remove any active timeouts to prevent callback after shutdown */
   if (self->timeout_id > 0) {
@@ -117,6 +154,8 @@ static void tilepaint_application_init(TilepaintApplication *self) {
 
   priv->debug = FALSE;
   priv->seed = 0;
+  priv->threads = 0;
+  priv->pack_path = NULL;
 }
 
 static void constructed(GObject *object) {
@@ -141,6 +180,10 @@ static void constructed(GObject *object) {
          number generation used when creating a board */
       {"seed", 0, 0, G_OPTION_ARG_INT, &(priv->seed),
        N_("Seed the board generation"), NULL},
+      {"threads", 0, 0, G_OPTION_ARG_INT, &(priv->threads),
+       N_("Number of threads to generate boards on"), N_("N")},
+      {"pack", 0, 0, G_OPTION_ARG_FILENAME, &(priv->pack_path),
+       N_("Load boards from a puzzle pack"), N_("FILE")},
       {NULL}};
 
   g_application_add_main_option_entries(G_APPLICATION(object), options);
@@ -220,6 +263,20 @@ static void startup(GApplication *application) {
                     application);
 }
 
+/* The sizes offered in the Board Size menu (data/tilepaint.blp), in
+ * increasing order. Boards are only prefetched for these and for the size
+ * being played. */
+static const guint menu_board_sizes[] = {5, 6, 7, 8, 9, 10, 15, 20, 25, 30};
+
+static gboolean start_prefetch_cb(gpointer user_data) {
+  TilepaintApplication *self = TILEPAINT_APPLICATION(user_data);
+
+  if (self->prefetch != NULL)
+    tilepaint_prefetch_start(self->prefetch);
+
+  return G_SOURCE_REMOVE;
+}
+
 static void activate(GApplication *application) {
   TilepaintApplication *self = TILEPAINT_APPLICATION(application);
   TilepaintApplicationPrivate *priv;
@@ -229,34 +286,69 @@ static void activate(GApplication *application) {
   /* Create the interface. */
   if (self->window == NULL) {
     GdkRectangle geometry;
-    TilepaintUndo *undo;
     gboolean window_maximized;
     gchar *size_str;
+    gchar *difficulty_str;
+    gchar *cache_path;
 
     /* Setup */
     self->debug = priv->debug;
+    /* GOptionContext happily parses a negative count, and more threads than
+     * processors would only add overhead */
+    if (priv->threads < 0) {
+      g_warning("--threads must not be negative; deciding by board size");
+      priv->threads = 0;
+    }
+    self->threads = MIN((guint)priv->threads, g_get_num_processors());
     self->settings = g_settings_new(APPLICATION_ID);
     size_str = g_settings_get_string(self->settings, "board-size");
     self->board_size = g_ascii_strtoull(size_str, NULL, 10);
     g_free(size_str);
 
-    if (self->board_size > MAX_BOARD_SIZE) {
+    if (self->board_size < MIN_BOARD_SIZE ||
+        self->board_size > MAX_BOARD_SIZE) {
       GVariant *default_size =
           g_settings_get_default_value(self->settings, "board-size");
       g_variant_get(default_size, "s", &size_str);
       g_variant_unref(default_size);
       self->board_size = g_ascii_strtoull(size_str, NULL, 10);
       g_free(size_str);
-      g_assert(self->board_size <= MAX_BOARD_SIZE);
+      g_assert(self->board_size >= MIN_BOARD_SIZE &&
+               self->board_size <= MAX_BOARD_SIZE);
     }
 
-    undo = g_new0(TilepaintUndo, 1);
-    undo->type = UNDO_NEW_GAME;
-    self->undo_stack = undo;
+    difficulty_str = g_settings_get_string(self->settings, "difficulty");
+    self->difficulty = tilepaint_difficulty_from_string(difficulty_str);
+    g_free(difficulty_str);
+
+    self->time_budget =
+        g_settings_get_uint(self->settings, "generation-time-limit") *
+        (gint64)1000;
+
+    if (priv->pack_path != NULL) {
+      GError *error = NULL;
+
+      self->pack = tilepaint_pack_open(priv->pack_path, &error);
+      if (self->pack == NULL) {
+        g_warning("Failed to open puzzle pack: %s", error->message);
+        g_error_free(error);
+      }
+      g_clear_pointer(&priv->pack_path, g_free);
+    }
+
+    self->undo_history = tilepaint_undo_history_new(MAX_UNDO_MOVES);
+
+    /* Boards left over from the last run can be played straight away */
+    cache_path =
+        g_build_filename(g_get_user_cache_dir(), PACKAGE, "boards.tppk", NULL);
+    self->prefetch = tilepaint_prefetch_new(
+        menu_board_sizes, G_N_ELEMENTS(menu_board_sizes), self->board_size,
+        PREFETCH_DEPTH, cache_path);
+    g_free(cache_path);
 
     /* Showtime! */
     tilepaint_create_interface(self);
-    tilepaint_generate_board(self, self->board_size, priv->seed);
+    start_game(self, self->board_size, priv->seed);
 
     /* Restore window position and size */
     window_maximized =
@@ -280,6 +372,9 @@ static void activate(GApplication *application) {
 
     gtk_window_set_application(GTK_WINDOW(self->window), GTK_APPLICATION(self));
     gtk_widget_set_visible(self->window, TRUE);
+
+    /* Only start building the next boards once the window is up */
+    g_idle_add_full(G_PRIORITY_LOW, start_prefetch_cb, self, NULL);
   }
 
   /* Bring it to the foreground */
@@ -290,11 +385,24 @@ TilepaintApplication *tilepaint_application_new(void) {
   return TILEPAINT_APPLICATION(g_object_new(TILEPAINT_TYPE_APPLICATION, NULL));
 }
 
-void tilepaint_new_game(Tilepaint *tilepaint, guint board_size) {
-  tilepaint->made_a_move = FALSE;
+static void start_game_cb(GObject *source, GAsyncResult *result,
+                          gpointer user_data) {
+  Tilepaint *tilepaint = TILEPAINT_APPLICATION(source);
+  GError *error = NULL;
+
+  if (!tilepaint_generate_board_finish(tilepaint, result, &error)) {
+    /* Whoever cancelled it has either quit or asked for another board */
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+      g_warning("Failed to build a board: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  g_clear_object(&tilepaint->generate_cancellable);
+  tilepaint_set_busy(tilepaint, FALSE);
 
-  tilepaint_generate_board(tilepaint, board_size, 0);
   tilepaint_clear_undo_stack(tilepaint);
+  tilepaint_enable_events(tilepaint);
   gtk_widget_queue_draw(tilepaint->drawing_area);
 
   tilepaint_reset_timer(tilepaint);
@@ -305,23 +413,29 @@ void tilepaint_new_game(Tilepaint *tilepaint, guint board_size) {
   tilepaint->cursor_position.y = 0;
 }
 
+/* Drops the game being played, or the board being built, and shows the busy
+ * state until the new board is ready */
+static void start_game(Tilepaint *tilepaint, guint board_size, guint seed) {
+  cancel_generation(tilepaint);
+
+  tilepaint->made_a_move = FALSE;
+  tilepaint_disable_events(tilepaint);
+  tilepaint_set_busy(tilepaint, TRUE);
+
+  tilepaint->requested_board_size = board_size;
+  tilepaint->generate_cancellable = g_cancellable_new();
+  tilepaint_generate_board_async(tilepaint, board_size, seed,
+                                 tilepaint->generate_cancellable,
+                                 start_game_cb, NULL);
+}
+
+void tilepaint_new_game(Tilepaint *tilepaint, guint board_size) {
+  start_game(tilepaint, board_size, 0);
+}
+
 void tilepaint_clear_undo_stack(Tilepaint *tilepaint) {
   /* Clear the undo stack */
-  if (tilepaint->undo_stack != NULL) {
-    while (tilepaint->undo_stack->redo != NULL)
-      tilepaint->undo_stack = tilepaint->undo_stack->redo;
-
-    while (tilepaint->undo_stack->undo != NULL) {
-      tilepaint->undo_stack = tilepaint->undo_stack->undo;
-      g_free(tilepaint->undo_stack->redo);
-      if (tilepaint->undo_stack->type == UNDO_NEW_GAME)
-        break;
-    }
-
-    /* Reset the "new game" item */
-    tilepaint->undo_stack->undo = NULL;
-    tilepaint->undo_stack->redo = NULL;
-  }
+  tilepaint_undo_history_clear(tilepaint->undo_history);
 
   g_simple_action_set_enabled(tilepaint->undo_action, FALSE);
   g_simple_action_set_enabled(tilepaint->redo_action, FALSE);
@@ -375,8 +489,10 @@ void tilepaint_print_board(Tilepaint *tilepaint) {
 
     for (iter.y = 0; iter.y < tilepaint->board_size; iter.y++) {
       for (iter.x = 0; iter.x < tilepaint->board_size; iter.x++) {
-        if ((tilepaint->board[iter.x][iter.y].status & CELL_PAINTED) == FALSE)
-          g_printf("%u ", tilepaint->board[iter.x][iter.y].tile_id);
+        const TilepaintCell *cell = tilepaint_cell(tilepaint, iter.x, iter.y);
+
+        if ((cell->status & CELL_PAINTED) == FALSE)
+          g_printf("%u ", cell->tile_id);
         else
           g_printf("X ");
       }
@@ -386,24 +502,233 @@ void tilepaint_print_board(Tilepaint *tilepaint) {
 }
 
 void tilepaint_free_board(Tilepaint *tilepaint) {
-  guint i;
-
   if (tilepaint->board == NULL)
     return;
 
-  for (i = 0; i < tilepaint->board_size; i++)
-    g_slice_free1(sizeof(TilepaintCell) * tilepaint->board_size,
-                  tilepaint->board[i]);
-  g_free(tilepaint->board);
-  tilepaint->board = NULL;
+  g_clear_pointer(&tilepaint->board, g_aligned_free);
+
+  g_clear_pointer(&tilepaint->row_clues, g_free);
+  g_clear_pointer(&tilepaint->col_clues, g_free);
+}
+
+/* Picks a random board of the given size and difficulty from the puzzle pack,
+ * or returns NULL if the pack has none */
+static TilepaintPuzzle *load_board_from_pack(Tilepaint *tilepaint, guint size,
+                                             TilepaintDifficulty difficulty) {
+  TilepaintPuzzle *puzzle;
+  GError *error = NULL;
+  gint pack_difficulty = difficulty == TILEPAINT_DIFFICULTY_ANY
+                             ? TILEPAINT_PACK_ANY_DIFFICULTY
+                             : (gint)difficulty;
+  guint n_puzzles;
+
+  n_puzzles =
+      tilepaint_pack_get_n_puzzles(tilepaint->pack, size, pack_difficulty);
+  if (n_puzzles == 0)
+    return NULL;
+
+  puzzle = tilepaint_pack_get_puzzle(
+      tilepaint->pack, size, pack_difficulty,
+      g_random_int_range(0, MIN(n_puzzles, G_MAXINT32)), &error);
+  if (puzzle == NULL) {
+    g_warning("Failed to load a board from the puzzle pack: %s",
+              error->message);
+    g_error_free(error);
+  }
+
+  return puzzle;
+}
+
+/* Once a generation runs out of time, takes a board of any difficulty from
+ * the puzzle pack or the prefetched ones rather than turn an earlier board.
+ * Called on whichever thread is generating. */
+static TilepaintPuzzle *generate_fallback_cb(guint size, gpointer user_data) {
+  Tilepaint *tilepaint = user_data;
+  TilepaintPuzzle *puzzle = NULL;
+
+  G_LOCK(fallback_sources);
+  if (tilepaint->pack != NULL)
+    puzzle = load_board_from_pack(tilepaint, size, TILEPAINT_DIFFICULTY_ANY);
+  if (puzzle == NULL && tilepaint->prefetch != NULL)
+    puzzle = tilepaint_prefetch_steal(tilepaint->prefetch, size);
+  G_UNLOCK(fallback_sources);
+
+  return puzzle;
+}
+
+typedef struct {
+  guint size;
+  TilepaintGeneratorOptions options;
+  TilepaintGeneratorStats stats;
+} GenerateData;
+
+static void log_generator_stats(Tilepaint *tilepaint, GenerateData *data) {
+  if (tilepaint->debug) {
+    gchar *json = tilepaint_generator_stats_to_json(&data->stats, data->size);
+
+    g_debug("Generator stats: %s", json);
+    g_free(json);
+  }
+}
+
+static void generate_board_thread(GTask *task, gpointer source_object,
+                                  gpointer task_data,
+                                  GCancellable *cancellable) {
+  GenerateData *data = task_data;
+  TilepaintPuzzle *puzzle;
+
+  puzzle = tilepaint_puzzle_generate(data->size, &data->options, cancellable);
+  if (puzzle == NULL) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                            "Board generation was cancelled");
+    return;
+  }
+
+  log_generator_stats(TILEPAINT_APPLICATION(source_object), data);
+  g_task_return_pointer(task, puzzle, (GDestroyNotify)tilepaint_puzzle_free);
+}
+
+static void generate_board_idle_cb(GObject *source, GAsyncResult *result,
+                                   gpointer user_data) {
+  GTask *task = G_TASK(user_data);
+  TilepaintPuzzle *puzzle;
+  GError *error = NULL;
+
+  puzzle = tilepaint_puzzle_generate_idle_finish(result, &error);
+  if (puzzle == NULL) {
+    g_task_return_error(task, error);
+  } else {
+    log_generator_stats(TILEPAINT_APPLICATION(g_task_get_source_object(task)),
+                        g_task_get_task_data(task));
+    g_task_return_pointer(task, puzzle, (GDestroyNotify)tilepaint_puzzle_free);
+  }
+
+  g_object_unref(task);
+}
+
+/* Builds a board without blocking the main loop. One from the puzzle pack,
+ * or one generated in the background if there's one ready, is used straight
+ * away unless a specific seed was requested. Otherwise boards big enough to
+ * race several candidates for are generated on worker threads, and smaller
+ * ones a slice at a time on the main context. Nothing changes until
+ * tilepaint_generate_board_finish() is called. */
+void tilepaint_generate_board_async(Tilepaint *tilepaint,
+                                    guint new_board_size, guint seed,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data) {
+  TilepaintPuzzle *puzzle = NULL;
+  GenerateData *data;
+  GTask *task;
+
+  g_return_if_fail(tilepaint != NULL);
+  g_return_if_fail(new_board_size > 0 &&
+                   new_board_size <= TILEPAINT_PUZZLE_MAX_SIZE);
+
+  task = g_task_new(tilepaint, cancellable, callback, user_data);
+  g_task_set_source_tag(task, tilepaint_generate_board_async);
+
+  if (seed == 0 && tilepaint->pack != NULL)
+    puzzle =
+        load_board_from_pack(tilepaint, new_board_size, tilepaint->difficulty);
+  if (seed == 0 && puzzle == NULL && tilepaint->prefetch != NULL)
+    puzzle = tilepaint_prefetch_pop(tilepaint->prefetch, new_board_size,
+                                    tilepaint->difficulty);
+
+  if (puzzle != NULL) {
+    g_task_return_pointer(task, puzzle, (GDestroyNotify)tilepaint_puzzle_free);
+    g_object_unref(task);
+    return;
+  }
+
+  data = g_new0(GenerateData, 1);
+  data->size = new_board_size;
+  data->options.seed = seed;
+  data->options.n_threads = tilepaint->threads;
+  data->options.stats = &data->stats;
+  data->options.difficulty = tilepaint->difficulty;
+  /* A requested seed must always give the same board */
+  data->options.time_budget = seed == 0 ? tilepaint->time_budget : 0;
+  data->options.fallback = generate_fallback_cb;
+  data->options.fallback_data = tilepaint;
+  g_task_set_task_data(task, data, g_free);
+
+  /* Race several candidates on the sizes where most of them fail */
+  if (data->options.n_threads == 0)
+    data->options.n_threads = new_board_size >= PARALLEL_MIN_BOARD_SIZE
+                                  ? g_get_num_processors()
+                                  : 1;
+
+  if (data->options.n_threads > 1)
+    g_task_run_in_thread(task, generate_board_thread);
+  else
+    tilepaint_puzzle_generate_idle_async(new_board_size, &data->options,
+                                         cancellable, generate_board_idle_cb,
+                                         g_object_ref(task));
+
+  g_object_unref(task);
+}
+
+/* Replaces the board with the one built, or returns FALSE with error set if
+ * the build was cancelled first */
+gboolean tilepaint_generate_board_finish(Tilepaint *tilepaint,
+                                         GAsyncResult *result, GError **error) {
+  TilepaintPuzzle *puzzle;
+  guint x, y;
+
+  g_return_val_if_fail(g_task_is_valid(result, tilepaint), FALSE);
+  g_return_val_if_fail(
+      g_async_result_is_tagged(result, tilepaint_generate_board_async), FALSE);
+
+  puzzle = g_task_propagate_pointer(G_TASK(result), error);
+  if (puzzle == NULL)
+    return FALSE;
+
+  /* Deallocate any previous board */
+  tilepaint_free_board(tilepaint);
+
+  tilepaint->board_size = puzzle->size;
+
+  /* Allocate the board */
+  tilepaint->board =
+      g_aligned_alloc0(tilepaint->board_size * tilepaint->board_size,
+                       sizeof(TilepaintCell), BOARD_ALIGNMENT);
+  tilepaint->row_clues = g_new(guchar, tilepaint->board_size);
+  tilepaint->col_clues = g_new(guchar, tilepaint->board_size);
+
+  memset(&tilepaint->painted, 0, sizeof(tilepaint->painted));
+  memset(&tilepaint->should_be_painted, 0,
+         sizeof(tilepaint->should_be_painted));
+  memset(&tilepaint->tag1, 0, sizeof(tilepaint->tag1));
+  memset(&tilepaint->tag2, 0, sizeof(tilepaint->tag2));
+  memset(&tilepaint->errors, 0, sizeof(tilepaint->errors));
+
+  /* Copy the puzzle in; only the secret goal is set for the player */
+  for (x = 0; x < tilepaint->board_size; x++) {
+    for (y = 0; y < tilepaint->board_size; y++) {
+      guint i = x * tilepaint->board_size + y;
+
+      tilepaint->board[i].tile_id = puzzle->tile_ids[i];
+      if (puzzle->solution[i])
+        tilepaint_toggle_cell(tilepaint, x, y, CELL_SHOULD_BE_PAINTED);
+    }
+
+    tilepaint->row_clues[x] = puzzle->row_clues[x];
+    tilepaint->col_clues[x] = puzzle->col_clues[x];
+  }
+
+  tilepaint_count_lines(tilepaint);
+  tilepaint_puzzle_free(puzzle);
+
+  return TRUE;
 }
 
 void tilepaint_enable_events(Tilepaint *tilepaint) {
   tilepaint->processing_events = TRUE;
 
-  if (tilepaint->undo_stack->redo != NULL)
+  if (tilepaint_undo_history_can_redo(tilepaint->undo_history))
     g_simple_action_set_enabled(tilepaint->redo_action, TRUE);
-  if (tilepaint->undo_stack->undo != NULL)
+  if (tilepaint_undo_history_can_undo(tilepaint->undo_history))
     g_simple_action_set_enabled(tilepaint->undo_action, TRUE);
   g_simple_action_set_enabled(tilepaint->hint_action, TRUE);
 
@@ -412,6 +737,8 @@ void tilepaint_enable_events(Tilepaint *tilepaint) {
 
 void tilepaint_disable_events(Tilepaint *tilepaint) {
   tilepaint->processing_events = FALSE;
+  /* A stroke mustn't carry on to whatever board comes next */
+  tilepaint->stroke_active = FALSE;
   g_simple_action_set_enabled(tilepaint->redo_action, FALSE);
   g_simple_action_set_enabled(tilepaint->undo_action, FALSE);
   g_simple_action_set_enabled(tilepaint->hint_action, FALSE);
@@ -23,12 +23,22 @@
 #ifndef TILEPAINT_MAIN_H
 #define TILEPAINT_MAIN_H
 
+#include "pack.h"
+#include "prefetch.h"
 #include "score.h"
+#include "undo.h"
 
 G_BEGIN_DECLS
 
 #define DEFAULT_BOARD_SIZE 5
-#define MAX_BOARD_SIZE 10
+#define MIN_BOARD_SIZE 5
+#define MAX_BOARD_SIZE 30
+
+/* Moves which can be undone; older ones are forgotten */
+#define MAX_UNDO_MOVES 65536
+
+/* Bytes the board's cells are aligned to: a cache line */
+#define BOARD_ALIGNMENT 64
 
 typedef struct {
   guchar x;
@@ -36,7 +46,6 @@ typedef struct {
 } TilepaintVector;
 
 typedef enum {
-  UNDO_NEW_GAME,
   UNDO_PAINT,
   UNDO_TAG1,
   UNDO_TAG2,
@@ -44,14 +53,6 @@ typedef enum {
   UNDO_TILE_PAINT
 } TilepaintUndoType;
 
-typedef struct _TilepaintUndo TilepaintUndo;
-struct _TilepaintUndo {
-  TilepaintUndoType type;
-  TilepaintVector cell;
-  TilepaintUndo *undo;
-  TilepaintUndo *redo;
-};
-
 typedef enum {
   CELL_PAINTED = 1 << 1,
   CELL_SHOULD_BE_PAINTED = 1 << 2,
@@ -73,9 +74,18 @@ typedef struct {
 
 typedef struct {
   guchar status;
-  guchar tile_id;
+  guint16 tile_id;
 } TilepaintCell;
 
+/* One flag of TilepaintCellStatus for the whole board, a line at a time: bit x
+ * of rows[y] and bit y of cols[x] are set for the cell at (x, y) */
+typedef struct {
+  guint32 rows[MAX_BOARD_SIZE];
+  guint32 cols[MAX_BOARD_SIZE];
+} TilepaintBitplane;
+
+G_STATIC_ASSERT(MAX_BOARD_SIZE <= 32);
+
 #define TILEPAINT_TYPE_APPLICATION (tilepaint_application_get_type())
 G_DECLARE_FINAL_TYPE(TilepaintApplication, tilepaint_application, TILEPAINT,
                      APPLICATION, GtkApplication)
@@ -103,14 +113,34 @@ struct _TilepaintApplication {
   PangoFontDescription *painted_font_desc;
 
   guchar board_size;
-  TilepaintCell **board;
-  guchar row_clues[MAX_BOARD_SIZE];
-  guchar col_clues[MAX_BOARD_SIZE];
+  TilepaintCell *board; /* board_size² cells, column by column */
+  guchar *row_clues; /* board_size long */
+  guchar *col_clues;
+  /* The cells' flags as bitplanes, kept in step by tilepaint_toggle_cell() */
+  TilepaintBitplane painted;
+  TilepaintBitplane should_be_painted;
+  TilepaintBitplane tag1;
+  TilepaintBitplane tag2;
+  TilepaintBitplane errors;
+  /* Painted cells in each line, and how many lines that makes wrong; kept by
+   * tilepaint_toggle_cell() once tilepaint_count_lines() has set them up */
+  guchar row_counts[MAX_BOARD_SIZE];
+  guchar col_counts[MAX_BOARD_SIZE];
+  guint n_wrong_lines;
+  TilepaintPrefetch *prefetch;
+  TilepaintPack *pack; /* puzzles to play before generating any */
+  GCancellable *generate_cancellable; /* of the board being built, if any */
+  /* Size of the board asked for last. It only becomes board_size once that
+   * board is built, so New Game and Play Again use this instead. */
+  guchar requested_board_size;
 
   gboolean debug;
+  guint threads; /* for board generation; 0 to decide by board size */
+  TilepaintDifficulty difficulty; /* of new boards, from the settings */
+  gint64 time_budget; /* for generating a board, in microseconds; 0 for none */
   gboolean processing_events;
   gboolean made_a_move;
-  TilepaintUndo *undo_stack;
+  TilepaintUndoHistory *undo_history;
 
   guint hint_status;
   TilepaintVector hint_position;
@@ -123,10 +153,22 @@ struct _TilepaintApplication {
   gboolean cursor_active;
   TilepaintVector cursor_position;
 
+  /* The drag being painted, if any; see tilepaint_drag_begin_cb() */
+  gboolean stroke_active;
+  TilepaintUndoType stroke_type;
+  guchar stroke_from; /* the first cell's flags which the stroke toggles */
+  TilepaintVector stroke_last; /* the cell the pointer was last over */
+
+  guint update_tick_id; /* for the redraw due on the next frame, if any */
+  gboolean update_recheck; /* whether to check for a win then too */
+
   gboolean is_paused;
   GtkWidget *pause_overlay;
   GtkWidget *pause_button;
 
+  gboolean is_busy; /* while the next board is built */
+  guint busy_tick_id;
+
   const TilepaintTheme *theme;
   GSettings *settings;
 };
@@ -137,10 +179,77 @@ tilepaint_application_new(void) G_GNUC_WARN_UNUSED_RESULT G_GNUC_MALLOC;
 /* FIXME: Backwards compatibility. This should be phased out eventually. */
 typedef TilepaintApplication Tilepaint;
 
+/* The cell in column x and row y; cells are laid out as in TilepaintPuzzle */
+static inline TilepaintCell *tilepaint_cell(Tilepaint *tilepaint, guint x,
+                                            guint y) {
+  return &tilepaint->board[x * tilepaint->board_size + y];
+}
+
+static inline void tilepaint_bitplane_toggle(TilepaintBitplane *plane, guint x,
+                                             guint y) {
+  plane->rows[y] ^= 1u << x;
+  plane->cols[x] ^= 1u << y;
+}
+
+/* How many cells of row y have the plane's flag set */
+static inline guint tilepaint_bitplane_row_count(const TilepaintBitplane *plane,
+                                                 guint y) {
+  return __builtin_popcount(plane->rows[y]);
+}
+
+/* How many cells of column x have the plane's flag set */
+static inline guint tilepaint_bitplane_col_count(const TilepaintBitplane *plane,
+                                                 guint x) {
+  return __builtin_popcount(plane->cols[x]);
+}
+
+/* Moves a line's painted count, keeping the count of wrong lines */
+static inline void tilepaint_line_count_add(Tilepaint *tilepaint, guchar *count,
+                                            guchar clue, gint delta) {
+  tilepaint->n_wrong_lines -= *count != clue;
+  *count += delta;
+  tilepaint->n_wrong_lines += *count != clue;
+}
+
+/* Flips the given TilepaintCellStatus flags of the cell at (x, y). Cell
+ * statuses must only be changed through here, to keep the bitplanes and line
+ * counts right. */
+static inline void tilepaint_toggle_cell(Tilepaint *tilepaint, guint x,
+                                         guint y, guchar flags) {
+  TilepaintCell *cell = tilepaint_cell(tilepaint, x, y);
+
+  cell->status ^= flags;
+
+  if (flags & CELL_PAINTED) {
+    gint delta = cell->status & CELL_PAINTED ? 1 : -1;
+
+    tilepaint_bitplane_toggle(&tilepaint->painted, x, y);
+    tilepaint_line_count_add(tilepaint, &tilepaint->row_counts[y],
+                             tilepaint->row_clues[y], delta);
+    tilepaint_line_count_add(tilepaint, &tilepaint->col_counts[x],
+                             tilepaint->col_clues[x], delta);
+  }
+  if (flags & CELL_SHOULD_BE_PAINTED)
+    tilepaint_bitplane_toggle(&tilepaint->should_be_painted, x, y);
+  if (flags & CELL_TAG1)
+    tilepaint_bitplane_toggle(&tilepaint->tag1, x, y);
+  if (flags & CELL_TAG2)
+    tilepaint_bitplane_toggle(&tilepaint->tag2, x, y);
+  if (flags & CELL_ERROR)
+    tilepaint_bitplane_toggle(&tilepaint->errors, x, y);
+}
+
 void tilepaint_new_game(Tilepaint *tilepaint, guint board_size);
 void tilepaint_clear_undo_stack(Tilepaint *tilepaint);
 void tilepaint_set_board_size(Tilepaint *tilepaint, guint board_size);
 void tilepaint_print_board(Tilepaint *tilepaint);
+void tilepaint_generate_board_async(Tilepaint *tilepaint,
+                                    guint new_board_size, guint seed,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
+gboolean tilepaint_generate_board_finish(Tilepaint *tilepaint,
+                                         GAsyncResult *result, GError **error);
 void tilepaint_free_board(Tilepaint *tilepaint);
 void tilepaint_enable_events(Tilepaint *tilepaint);
 void tilepaint_disable_events(Tilepaint *tilepaint);
@@ -0,0 +1,650 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "generator.h"
+#include "pack.h"
+
+/* A pack is a little-endian file laid out as:
+ *
+ *   header      "TPPK", version (u32), number of groups (u32), reserved (u32)
+ *   groups      size (u8), difficulty (u8, a TilepaintDifficulty), record
+ *               size (u16), count (u32), offset of the first record (u64);
+ *               sorted by size, difficulty
+ *   records     fixed-size for each board size, packed back to back
+ *
+ * Each record holds an FNV-1a checksum (u32) of the rest of the record, then
+ * one bit per pair of neighbouring cells saying whether they share a tile,
+ * one bit per cell of the solution, and the row and column clues as bytes.
+ * Since every tile is a connected region, the neighbour bits are enough to
+ * rebuild the tile ids. Cells are visited in the puzzle's [x * size + y]
+ * order throughout. */
+#define PACK_MAGIC "TPPK"
+#define PACK_VERSION 1
+#define PACK_HEADER_SIZE 16
+#define PACK_GROUP_SIZE 16
+#define PACK_CHECKSUM_SIZE 4
+
+/* A fingerprint index is a little-endian file laid out as:
+ *
+ *   header      "TPFX", version (u32), number of fingerprints (u32),
+ *               log2 of the number of slots (u32)
+ *   slots       a fingerprint (u64) or 0 for an empty slot
+ *
+ * The slots are an open-addressed hash table, probed linearly from the
+ * fingerprint's low bits, and kept at most half full. It is read straight
+ * into memory and looked up and added to in the same layout. */
+#define INDEX_MAGIC "TPFX"
+#define INDEX_VERSION 1
+#define INDEX_HEADER_SIZE 16
+#define INDEX_MIN_SLOTS_LOG2 10
+#define INDEX_MAX_SLOTS_LOG2 31
+
+typedef struct {
+  guint size;
+  guint difficulty;
+  gsize record_size;
+  guint count;
+  const guchar *records;
+} PackGroup;
+
+struct _TilepaintPack {
+  GMappedFile *file;
+  PackGroup *groups;
+  guint n_groups;
+
+  /* Groups for board size s are [first_group[s], first_group[s + 1]) */
+  guint first_group[TILEPAINT_PUZZLE_MAX_SIZE + 2];
+};
+
+typedef struct {
+  guint size;
+  guint difficulty;
+  GByteArray *records;
+} WriterGroup;
+
+struct _TilepaintPackWriter {
+  GArray *groups; /* of WriterGroup */
+};
+
+struct _TilepaintFingerprintIndex {
+  guint64 *slots;
+  guint slots_log2;
+  guint count;
+};
+
+G_DEFINE_QUARK(tilepaint-pack-error-quark, tilepaint_pack_error)
+
+static gsize pack_record_size(guint size) {
+  return PACK_CHECKSUM_SIZE + (2 * size * (size - 1) + 7) / 8 +
+         (size * size + 7) / 8 + 2 * size;
+}
+
+static guint32 pack_checksum(const guchar *data, gsize length) {
+  guint32 hash = 2166136261u;
+  gsize i;
+
+  for (i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+static guint16 read_u16(const guchar *data) {
+  guint16 value;
+
+  memcpy(&value, data, sizeof(value));
+  return GUINT16_FROM_LE(value);
+}
+
+static guint32 read_u32(const guchar *data) {
+  guint32 value;
+
+  memcpy(&value, data, sizeof(value));
+  return GUINT32_FROM_LE(value);
+}
+
+static void write_u32(guchar *data, guint32 value) {
+  value = GUINT32_TO_LE(value);
+  memcpy(data, &value, sizeof(value));
+}
+
+#define bit_get(bits, i) (((bits)[(i) / 8] >> ((i) % 8)) & 1)
+#define bit_set(bits, i) ((bits)[(i) / 8] |= 1 << ((i) % 8))
+
+static void pack_encode(const TilepaintPuzzle *puzzle, guchar *record) {
+  guint size = puzzle->size;
+  guchar *edges = record + PACK_CHECKSUM_SIZE;
+  guchar *solution = edges + (2 * size * (size - 1) + 7) / 8;
+  guchar *clues = solution + (size * size + 7) / 8;
+  guint x, y, bit = 0;
+
+  memset(record, 0, pack_record_size(size));
+
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      guint i = x * size + y;
+
+      if (x + 1 < size) {
+        if (puzzle->tile_ids[i] == puzzle->tile_ids[i + size])
+          bit_set(edges, bit);
+        bit++;
+      }
+      if (y + 1 < size) {
+        if (puzzle->tile_ids[i] == puzzle->tile_ids[i + 1])
+          bit_set(edges, bit);
+        bit++;
+      }
+
+      if (puzzle->solution[i])
+        bit_set(solution, i);
+    }
+  }
+
+  memcpy(clues, puzzle->row_clues, size);
+  memcpy(clues + size, puzzle->col_clues, size);
+
+  write_u32(record, pack_checksum(record + PACK_CHECKSUM_SIZE,
+                                  pack_record_size(size) - PACK_CHECKSUM_SIZE));
+}
+
+static guint pack_find_root(guint *parent, guint i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+
+  return i;
+}
+
+static TilepaintPuzzle *pack_decode(const guchar *record, guint size,
+                                    GError **error) {
+  const guchar *edges = record + PACK_CHECKSUM_SIZE;
+  const guchar *solution = edges + (2 * size * (size - 1) + 7) / 8;
+  const guchar *clues = solution + (size * size + 7) / 8;
+  guint parent[TILEPAINT_PUZZLE_MAX_SIZE * TILEPAINT_PUZZLE_MAX_SIZE];
+  gint root_id[TILEPAINT_PUZZLE_MAX_SIZE * TILEPAINT_PUZZLE_MAX_SIZE];
+  TilepaintPuzzle *puzzle;
+  guint x, y, i, bit = 0;
+
+  if (read_u32(record) !=
+      pack_checksum(edges, pack_record_size(size) - PACK_CHECKSUM_SIZE)) {
+    g_set_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_CORRUPT,
+                "Checksum mismatch in a %u×%u puzzle", size, size);
+    return NULL;
+  }
+
+  /* Join neighbouring cells into tiles */
+  for (i = 0; i < size * size; i++) {
+    parent[i] = i;
+    root_id[i] = -1;
+  }
+
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      i = x * size + y;
+
+      if (x + 1 < size) {
+        if (bit_get(edges, bit))
+          parent[pack_find_root(parent, i + size)] = pack_find_root(parent, i);
+        bit++;
+      }
+      if (y + 1 < size) {
+        if (bit_get(edges, bit))
+          parent[pack_find_root(parent, i + 1)] = pack_find_root(parent, i);
+        bit++;
+      }
+    }
+  }
+
+  /* Number the tiles in cell order, as the generator does */
+  puzzle = tilepaint_puzzle_new(size);
+
+  for (i = 0; i < size * size; i++) {
+    guint root = pack_find_root(parent, i);
+
+    if (root_id[root] < 0)
+      root_id[root] = puzzle->num_tiles++;
+
+    puzzle->tile_ids[i] = root_id[root];
+    puzzle->solution[i] = bit_get(solution, i);
+  }
+
+  memcpy(puzzle->row_clues, clues, size);
+  memcpy(puzzle->col_clues, clues + size, size);
+
+  return puzzle;
+}
+
+TilepaintPack *tilepaint_pack_open(const gchar *filename, GError **error) {
+  TilepaintPack *pack;
+  GMappedFile *file;
+  const guchar *data;
+  guint64 length;
+  guint n_groups, i, size;
+
+  g_return_val_if_fail(filename != NULL, NULL);
+
+  file = g_mapped_file_new(filename, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  data = (const guchar *)g_mapped_file_get_contents(file);
+  length = g_mapped_file_get_length(file);
+
+  if (length < PACK_HEADER_SIZE ||
+      memcmp(data, PACK_MAGIC, strlen(PACK_MAGIC)) != 0 ||
+      read_u32(data + 4) != PACK_VERSION ||
+      length < PACK_HEADER_SIZE +
+                   (guint64)read_u32(data + 8) * PACK_GROUP_SIZE) {
+    g_set_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_INVALID,
+                "%s is not a supported puzzle pack", filename);
+    g_mapped_file_unref(file);
+    return NULL;
+  }
+
+  n_groups = read_u32(data + 8);
+
+  pack = g_new0(TilepaintPack, 1);
+  pack->file = file;
+  pack->groups = g_new(PackGroup, n_groups);
+  pack->n_groups = n_groups;
+
+  for (i = 0; i < n_groups; i++) {
+    const guchar *entry = data + PACK_HEADER_SIZE + i * PACK_GROUP_SIZE;
+    PackGroup *group = &pack->groups[i];
+    guint64 offset;
+
+    group->size = entry[0];
+    group->difficulty = entry[1];
+    group->record_size = read_u16(entry + 2);
+    group->count = read_u32(entry + 4);
+    offset = (guint64)read_u32(entry + 8) | (guint64)read_u32(entry + 12) << 32;
+
+    /* Groups must be in order, in bounds and sized for their board */
+    if (group->size < 1 || group->size > TILEPAINT_PUZZLE_MAX_SIZE ||
+        group->record_size != pack_record_size(group->size) ||
+        offset > length ||
+        (length - offset) / group->record_size < group->count ||
+        (i > 0 && (group->size < group[-1].size ||
+                   (group->size == group[-1].size &&
+                    group->difficulty <= group[-1].difficulty)))) {
+      g_set_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_INVALID,
+                  "%s has an invalid index", filename);
+      tilepaint_pack_free(pack);
+      return NULL;
+    }
+
+    group->records = data + offset;
+  }
+
+  /* Index the groups by board size */
+  for (size = 0, i = 0; size <= TILEPAINT_PUZZLE_MAX_SIZE + 1; size++) {
+    while (i < n_groups && pack->groups[i].size < size)
+      i++;
+    pack->first_group[size] = i;
+  }
+
+  return pack;
+}
+
+void tilepaint_pack_free(TilepaintPack *pack) {
+  if (pack == NULL)
+    return;
+
+  g_mapped_file_unref(pack->file);
+  g_free(pack->groups);
+  g_free(pack);
+}
+
+guint tilepaint_pack_get_n_puzzles(TilepaintPack *pack, guint size,
+                                   gint difficulty) {
+  guint i, n_puzzles = 0;
+
+  g_return_val_if_fail(pack != NULL, 0);
+
+  if (size < 1 || size > TILEPAINT_PUZZLE_MAX_SIZE)
+    return 0;
+
+  for (i = pack->first_group[size]; i < pack->first_group[size + 1]; i++) {
+    if (difficulty == TILEPAINT_PACK_ANY_DIFFICULTY ||
+        pack->groups[i].difficulty == (guint)difficulty)
+      n_puzzles += pack->groups[i].count;
+  }
+
+  return n_puzzles;
+}
+
+/* Returns puzzle number `index` of those matching size and difficulty, decoded
+ * straight from the mapping without running the solver. */
+TilepaintPuzzle *tilepaint_pack_get_puzzle(TilepaintPack *pack, guint size,
+                                           gint difficulty, guint index,
+                                           GError **error) {
+  guint i;
+
+  g_return_val_if_fail(pack != NULL, NULL);
+  g_return_val_if_fail(size >= 1 && size <= TILEPAINT_PUZZLE_MAX_SIZE, NULL);
+
+  for (i = pack->first_group[size]; i < pack->first_group[size + 1]; i++) {
+    const PackGroup *group = &pack->groups[i];
+
+    if (difficulty != TILEPAINT_PACK_ANY_DIFFICULTY &&
+        group->difficulty != (guint)difficulty)
+      continue;
+
+    if (index < group->count) {
+      TilepaintPuzzle *puzzle = pack_decode(
+          group->records + index * group->record_size, size, error);
+
+      if (puzzle != NULL && group->difficulty <= TILEPAINT_DIFFICULTY_HARD)
+        puzzle->difficulty = group->difficulty;
+
+      return puzzle;
+    }
+
+    index -= group->count;
+  }
+
+  g_return_val_if_reached(NULL);
+}
+
+TilepaintPackWriter *tilepaint_pack_writer_new(void) {
+  TilepaintPackWriter *writer = g_new0(TilepaintPackWriter, 1);
+
+  writer->groups = g_array_new(FALSE, FALSE, sizeof(WriterGroup));
+
+  return writer;
+}
+
+void tilepaint_pack_writer_free(TilepaintPackWriter *writer) {
+  guint i;
+
+  if (writer == NULL)
+    return;
+
+  for (i = 0; i < writer->groups->len; i++)
+    g_byte_array_unref(g_array_index(writer->groups, WriterGroup, i).records);
+  g_array_unref(writer->groups);
+  g_free(writer);
+}
+
+void tilepaint_pack_writer_add(TilepaintPackWriter *writer,
+                               const TilepaintPuzzle *puzzle,
+                               guint difficulty) {
+  WriterGroup *group = NULL;
+  gsize record_size;
+  guint i;
+
+  g_return_if_fail(writer != NULL);
+  g_return_if_fail(puzzle != NULL);
+  g_return_if_fail(puzzle->size >= 1 &&
+                   puzzle->size <= TILEPAINT_PUZZLE_MAX_SIZE);
+  g_return_if_fail(difficulty <= G_MAXUINT8);
+
+  for (i = 0; i < writer->groups->len && group == NULL; i++) {
+    WriterGroup *candidate = &g_array_index(writer->groups, WriterGroup, i);
+
+    if (candidate->size == puzzle->size && candidate->difficulty == difficulty)
+      group = candidate;
+  }
+
+  if (group == NULL) {
+    WriterGroup new_group = {puzzle->size, difficulty, g_byte_array_new()};
+
+    g_array_append_val(writer->groups, new_group);
+    group = &g_array_index(writer->groups, WriterGroup, writer->groups->len - 1);
+  }
+
+  record_size = pack_record_size(puzzle->size);
+  g_byte_array_set_size(group->records, group->records->len + record_size);
+  pack_encode(puzzle, group->records->data + group->records->len - record_size);
+}
+
+static gint writer_group_compare(gconstpointer a, gconstpointer b) {
+  const WriterGroup *group_a = a, *group_b = b;
+
+  if (group_a->size != group_b->size)
+    return group_a->size < group_b->size ? -1 : 1;
+  if (group_a->difficulty != group_b->difficulty)
+    return group_a->difficulty < group_b->difficulty ? -1 : 1;
+  return 0;
+}
+
+/* Writes every puzzle added so far, replacing the file atomically */
+gboolean tilepaint_pack_writer_save(TilepaintPackWriter *writer,
+                                    const gchar *filename, GError **error) {
+  GByteArray *output;
+  guint64 offset;
+  gboolean success;
+  guint i;
+
+  g_return_val_if_fail(writer != NULL, FALSE);
+  g_return_val_if_fail(filename != NULL, FALSE);
+
+  g_array_sort(writer->groups, writer_group_compare);
+
+  offset = PACK_HEADER_SIZE + writer->groups->len * PACK_GROUP_SIZE;
+  output = g_byte_array_sized_new(offset);
+  g_byte_array_set_size(output, offset);
+
+  memcpy(output->data, PACK_MAGIC, strlen(PACK_MAGIC));
+  write_u32(output->data + 4, PACK_VERSION);
+  write_u32(output->data + 8, writer->groups->len);
+  write_u32(output->data + 12, 0);
+
+  for (i = 0; i < writer->groups->len; i++) {
+    const WriterGroup *group = &g_array_index(writer->groups, WriterGroup, i);
+    guchar *entry = output->data + PACK_HEADER_SIZE + i * PACK_GROUP_SIZE;
+    guint16 record_size = GUINT16_TO_LE(pack_record_size(group->size));
+
+    entry[0] = group->size;
+    entry[1] = group->difficulty;
+    memcpy(entry + 2, &record_size, sizeof(record_size));
+    write_u32(entry + 4, group->records->len / pack_record_size(group->size));
+    write_u32(entry + 8, offset & G_MAXUINT32);
+    write_u32(entry + 12, offset >> 32);
+
+    offset += group->records->len;
+  }
+
+  for (i = 0; i < writer->groups->len; i++) {
+    const WriterGroup *group = &g_array_index(writer->groups, WriterGroup, i);
+
+    g_byte_array_append(output, group->records->data, group->records->len);
+  }
+
+  success = g_file_set_contents(filename, (const gchar *)output->data,
+                                output->len, error);
+  g_byte_array_unref(output);
+
+  return success;
+}
+
+TilepaintFingerprintIndex *tilepaint_fingerprint_index_new(void) {
+  TilepaintFingerprintIndex *index = g_new0(TilepaintFingerprintIndex, 1);
+
+  index->slots_log2 = INDEX_MIN_SLOTS_LOG2;
+  index->slots = g_new0(guint64, 1u << index->slots_log2);
+
+  return index;
+}
+
+/* Reads an index saved by tilepaint_fingerprint_index_save() */
+TilepaintFingerprintIndex *
+tilepaint_fingerprint_index_load(const gchar *filename, GError **error) {
+  TilepaintFingerprintIndex *index;
+  gchar *contents;
+  gsize length;
+  const guchar *data;
+  guint slots_log2, count, i, used = 0;
+
+  g_return_val_if_fail(filename != NULL, NULL);
+
+  if (!g_file_get_contents(filename, &contents, &length, error))
+    return NULL;
+
+  data = (const guchar *)contents;
+  slots_log2 = length >= INDEX_HEADER_SIZE ? read_u32(data + 12) : 0;
+  count = length >= INDEX_HEADER_SIZE ? read_u32(data + 8) : 0;
+
+  if (length < INDEX_HEADER_SIZE ||
+      memcmp(data, INDEX_MAGIC, strlen(INDEX_MAGIC)) != 0 ||
+      read_u32(data + 4) != INDEX_VERSION ||
+      slots_log2 < INDEX_MIN_SLOTS_LOG2 || slots_log2 > INDEX_MAX_SLOTS_LOG2 ||
+      length != INDEX_HEADER_SIZE + ((gsize)sizeof(guint64) << slots_log2) ||
+      count > (1u << slots_log2) / 2) {
+    g_set_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_INVALID,
+                "%s is not a supported fingerprint index", filename);
+    g_free(contents);
+    return NULL;
+  }
+
+  index = g_new0(TilepaintFingerprintIndex, 1);
+  index->slots_log2 = slots_log2;
+  index->count = count;
+  index->slots = g_new(guint64, 1u << slots_log2);
+
+  for (i = 0; i < 1u << slots_log2; i++) {
+    memcpy(&index->slots[i], data + INDEX_HEADER_SIZE + i * sizeof(guint64),
+           sizeof(guint64));
+    index->slots[i] = GUINT64_FROM_LE(index->slots[i]);
+    used += index->slots[i] != 0;
+  }
+
+  g_free(contents);
+
+  if (used != count) {
+    g_set_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_CORRUPT,
+                "%s holds %u fingerprints rather than %u", filename, used,
+                count);
+    tilepaint_fingerprint_index_free(index);
+    return NULL;
+  }
+
+  return index;
+}
+
+void tilepaint_fingerprint_index_free(TilepaintFingerprintIndex *index) {
+  if (index == NULL)
+    return;
+
+  g_free(index->slots);
+  g_free(index);
+}
+
+/* Returns the slot holding fingerprint, or the empty one where it would go */
+static guint64 *index_find_slot(guint64 *slots, guint slots_log2,
+                                guint64 fingerprint) {
+  guint mask = (1u << slots_log2) - 1;
+  guint i = fingerprint & mask;
+
+  while (slots[i] != 0 && slots[i] != fingerprint)
+    i = (i + 1) & mask;
+
+  return &slots[i];
+}
+
+gboolean tilepaint_fingerprint_index_contains(TilepaintFingerprintIndex *index,
+                                              guint64 fingerprint) {
+  g_return_val_if_fail(index != NULL, FALSE);
+  g_return_val_if_fail(fingerprint != 0, FALSE);
+
+  return *index_find_slot(index->slots, index->slots_log2, fingerprint) != 0;
+}
+
+/* Adds a fingerprint, returning FALSE if it was already there */
+gboolean tilepaint_fingerprint_index_add(TilepaintFingerprintIndex *index,
+                                         guint64 fingerprint) {
+  guint64 *slot;
+
+  g_return_val_if_fail(index != NULL, FALSE);
+  g_return_val_if_fail(fingerprint != 0, FALSE);
+
+  slot = index_find_slot(index->slots, index->slots_log2, fingerprint);
+  if (*slot != 0)
+    return FALSE;
+
+  /* Keep probes short by staying at most half full */
+  if (index->count + 1 > (1u << index->slots_log2) / 2) {
+    guint slots_log2 = index->slots_log2 + 1;
+    guint64 *slots;
+    guint i;
+
+    g_return_val_if_fail(slots_log2 <= INDEX_MAX_SLOTS_LOG2, FALSE);
+
+    slots = g_new0(guint64, 1u << slots_log2);
+    for (i = 0; i < 1u << index->slots_log2; i++) {
+      if (index->slots[i] != 0)
+        *index_find_slot(slots, slots_log2, index->slots[i]) = index->slots[i];
+    }
+
+    g_free(index->slots);
+    index->slots = slots;
+    index->slots_log2 = slots_log2;
+    slot = index_find_slot(slots, slots_log2, fingerprint);
+  }
+
+  *slot = fingerprint;
+  index->count++;
+
+  return TRUE;
+}
+
+guint tilepaint_fingerprint_index_get_size(TilepaintFingerprintIndex *index) {
+  g_return_val_if_fail(index != NULL, 0);
+
+  return index->count;
+}
+
+/* Writes the index out, replacing the file atomically */
+gboolean tilepaint_fingerprint_index_save(TilepaintFingerprintIndex *index,
+                                          const gchar *filename,
+                                          GError **error) {
+  gsize length;
+  guchar *output;
+  gboolean success;
+  guint i;
+
+  g_return_val_if_fail(index != NULL, FALSE);
+  g_return_val_if_fail(filename != NULL, FALSE);
+
+  length = INDEX_HEADER_SIZE + ((gsize)sizeof(guint64) << index->slots_log2);
+  output = g_malloc(length);
+
+  memcpy(output, INDEX_MAGIC, strlen(INDEX_MAGIC));
+  write_u32(output + 4, INDEX_VERSION);
+  write_u32(output + 8, index->count);
+  write_u32(output + 12, index->slots_log2);
+
+  for (i = 0; i < 1u << index->slots_log2; i++) {
+    guint64 slot = GUINT64_TO_LE(index->slots[i]);
+
+    memcpy(output + INDEX_HEADER_SIZE + i * sizeof(guint64), &slot,
+           sizeof(slot));
+  }
+
+  success = g_file_set_contents(filename, (const gchar *)output, length, error);
+  g_free(output);
+
+  return success;
+}
@@ -0,0 +1,83 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEPAINT_PACK_H
+#define TILEPAINT_PACK_H
+
+#include <glib.h>
+
+#include "generator.h"
+
+G_BEGIN_DECLS
+
+/* Matches puzzles of every difficulty in tilepaint_pack_get_n_puzzles() and
+ * tilepaint_pack_get_puzzle() */
+#define TILEPAINT_PACK_ANY_DIFFICULTY (-1)
+
+#define TILEPAINT_PACK_ERROR (tilepaint_pack_error_quark())
+
+typedef enum {
+  TILEPAINT_PACK_ERROR_INVALID, /* not a pack, or an unsupported version */
+  TILEPAINT_PACK_ERROR_CORRUPT, /* a record failed its checksum */
+} TilepaintPackError;
+
+/* A read-only, memory-mapped collection of verified puzzles */
+typedef struct _TilepaintPack TilepaintPack;
+
+/* Collects puzzles in memory and writes them out as a pack */
+typedef struct _TilepaintPackWriter TilepaintPackWriter;
+
+/* A set of puzzle fingerprints (see tilepaint_puzzle_fingerprint()), kept in a
+ * file between batch runs so that no board is generated twice */
+typedef struct _TilepaintFingerprintIndex TilepaintFingerprintIndex;
+
+GQuark tilepaint_pack_error_quark(void);
+
+TilepaintPack *tilepaint_pack_open(const gchar *filename, GError **error);
+void tilepaint_pack_free(TilepaintPack *pack);
+guint tilepaint_pack_get_n_puzzles(TilepaintPack *pack, guint size,
+                                   gint difficulty);
+TilepaintPuzzle *tilepaint_pack_get_puzzle(TilepaintPack *pack, guint size,
+                                           gint difficulty, guint index,
+                                           GError **error);
+
+TilepaintPackWriter *tilepaint_pack_writer_new(void);
+void tilepaint_pack_writer_free(TilepaintPackWriter *writer);
+void tilepaint_pack_writer_add(TilepaintPackWriter *writer,
+                               const TilepaintPuzzle *puzzle,
+                               guint difficulty);
+gboolean tilepaint_pack_writer_save(TilepaintPackWriter *writer,
+                                    const gchar *filename, GError **error);
+
+TilepaintFingerprintIndex *tilepaint_fingerprint_index_new(void);
+TilepaintFingerprintIndex *
+tilepaint_fingerprint_index_load(const gchar *filename, GError **error);
+void tilepaint_fingerprint_index_free(TilepaintFingerprintIndex *index);
+gboolean tilepaint_fingerprint_index_contains(TilepaintFingerprintIndex *index,
+                                              guint64 fingerprint);
+gboolean tilepaint_fingerprint_index_add(TilepaintFingerprintIndex *index,
+                                         guint64 fingerprint);
+guint tilepaint_fingerprint_index_get_size(TilepaintFingerprintIndex *index);
+gboolean tilepaint_fingerprint_index_save(TilepaintFingerprintIndex *index,
+                                          const gchar *filename,
+                                          GError **error);
+
+G_END_DECLS
+
+#endif /* TILEPAINT_PACK_H */
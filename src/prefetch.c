@@ -0,0 +1,387 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <gio/gio.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "generator.h"
+#include "pack.h"
+#include "prefetch.h"
+
+/* The worker keeps `depth` boards ready for the size and difficulty currently
+ * being played and one for every other size the player can pick, so that New
+ * Game, Play Again and switching board size can all be served without running
+ * the generator on the main thread. The boards are also kept in a cache file between runs, so
+ * that even the first board after startup needn't be generated. */
+struct _TilepaintPrefetch {
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  GCancellable *cancellable;
+
+  guint *sizes; /* that can be picked, in increasing order */
+  guint n_sizes;
+  guint min_size;
+  guint max_size;
+  guint preferred_size;
+  TilepaintDifficulty preferred_difficulty;
+  guint depth;
+  GQueue *queues; /* of TilepaintPuzzle, indexed by size - min_size */
+
+  gchar *cache_path; /* NULL to not keep boards between runs */
+  gboolean cache_dirty; /* whether the queues have changed since the save */
+};
+
+#define prefetch_queue(prefetch, size)                                         \
+  (&(prefetch)->queues[(size) - (prefetch)->min_size])
+
+/* How many boards, as a multiple of `depth`, may pile up for the preferred
+ * size while looking for ones of the preferred difficulty. The generator
+ * falls back to any difficulty when one is too rare at a size. */
+#define PREFETCH_MAX_QUEUED 4
+
+static gboolean puzzle_matches(const TilepaintPuzzle *puzzle,
+                               TilepaintDifficulty difficulty) {
+  return difficulty == TILEPAINT_DIFFICULTY_ANY ||
+         puzzle->difficulty == difficulty;
+}
+
+static guint prefetch_count(GQueue *queue, TilepaintDifficulty difficulty) {
+  guint n = 0;
+  GList *l;
+
+  for (l = queue->head; l != NULL; l = l->next)
+    n += puzzle_matches(l->data, difficulty);
+
+  return n;
+}
+
+static gboolean prefetch_offers_size(TilepaintPrefetch *prefetch,
+                                     guint size) {
+  guint i;
+
+  for (i = 0; i < prefetch->n_sizes; i++) {
+    if (prefetch->sizes[i] == size)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns the size which most needs a board, or 0 if every queue is full.
+ * Must be called with the lock held. */
+static guint prefetch_next_size(TilepaintPrefetch *prefetch) {
+  GQueue *preferred = prefetch_queue(prefetch, prefetch->preferred_size);
+  guint i;
+
+  if (prefetch_count(preferred, prefetch->preferred_difficulty) <
+          prefetch->depth &&
+      g_queue_get_length(preferred) < PREFETCH_MAX_QUEUED * prefetch->depth)
+    return prefetch->preferred_size;
+
+  for (i = 0; i < prefetch->n_sizes; i++) {
+    if (g_queue_is_empty(prefetch_queue(prefetch, prefetch->sizes[i])))
+      return prefetch->sizes[i];
+  }
+
+  return 0;
+}
+
+static void prefetch_load_cache(TilepaintPrefetch *prefetch) {
+  TilepaintPack *pack;
+  GError *error = NULL;
+  guint size;
+
+  pack = tilepaint_pack_open(prefetch->cache_path, &error);
+  if (pack == NULL) {
+    if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      g_warning("Failed to load cached boards: %s", error->message);
+    g_error_free(error);
+    return;
+  }
+
+  for (size = prefetch->min_size; size <= prefetch->max_size; size++) {
+    guint n_puzzles;
+    guint i;
+
+    /* Sizes that can no longer be picked are left to drop out of the cache */
+    if (!prefetch_offers_size(prefetch, size) &&
+        size != prefetch->preferred_size)
+      continue;
+
+    n_puzzles = tilepaint_pack_get_n_puzzles(pack, size,
+                                             TILEPAINT_PACK_ANY_DIFFICULTY);
+
+    for (i = 0; i < MIN(n_puzzles, prefetch->depth); i++) {
+      TilepaintPuzzle *puzzle = tilepaint_pack_get_puzzle(
+          pack, size, TILEPAINT_PACK_ANY_DIFFICULTY, i, &error);
+
+      if (puzzle == NULL) {
+        g_warning("Failed to load a cached board: %s", error->message);
+        g_clear_error(&error);
+        continue;
+      }
+
+      g_queue_push_tail(prefetch_queue(prefetch, size), puzzle);
+    }
+  }
+
+  tilepaint_pack_free(pack);
+}
+
+/* Copies every queued board into a pack writer. Must be called with the lock
+ * held. */
+static TilepaintPackWriter *prefetch_snapshot(TilepaintPrefetch *prefetch) {
+  TilepaintPackWriter *writer = tilepaint_pack_writer_new();
+  guint size;
+
+  for (size = prefetch->min_size; size <= prefetch->max_size; size++) {
+    GList *l;
+
+    for (l = prefetch_queue(prefetch, size)->head; l != NULL; l = l->next) {
+      const TilepaintPuzzle *puzzle = l->data;
+
+      tilepaint_pack_writer_add(writer, puzzle, puzzle->difficulty);
+    }
+  }
+
+  prefetch->cache_dirty = FALSE;
+
+  return writer;
+}
+
+static void prefetch_save_cache(TilepaintPrefetch *prefetch,
+                                TilepaintPackWriter *writer) {
+  GError *error = NULL;
+  gchar *dirname = g_path_get_dirname(prefetch->cache_path);
+
+  if (g_mkdir_with_parents(dirname, 0700) != 0 ||
+      !tilepaint_pack_writer_save(writer, prefetch->cache_path, &error)) {
+    g_warning("Failed to save cached boards to %s: %s", prefetch->cache_path,
+              error != NULL ? error->message : g_strerror(errno));
+    g_clear_error(&error);
+  }
+
+  g_free(dirname);
+  tilepaint_pack_writer_free(writer);
+}
+
+static gpointer prefetch_thread(gpointer user_data) {
+  TilepaintPrefetch *prefetch = user_data;
+
+  g_mutex_lock(&prefetch->lock);
+
+  while (!g_cancellable_is_cancelled(prefetch->cancellable)) {
+    TilepaintPuzzle *puzzle;
+    TilepaintGeneratorStats stats = {0};
+    TilepaintGeneratorOptions options = {0, 1, &stats};
+    guint size = prefetch_next_size(prefetch);
+
+    if (size == prefetch->preferred_size)
+      options.difficulty = prefetch->preferred_difficulty;
+
+    if (size == 0) {
+      /* Everything's ready, so write it out in case we don't exit cleanly */
+      if (prefetch->cache_path != NULL && prefetch->cache_dirty) {
+        TilepaintPackWriter *writer = prefetch_snapshot(prefetch);
+
+        g_mutex_unlock(&prefetch->lock);
+        prefetch_save_cache(prefetch, writer);
+        g_mutex_lock(&prefetch->lock);
+        continue;
+      }
+
+      g_cond_wait(&prefetch->cond, &prefetch->lock);
+      continue;
+    }
+
+    /* Generation can take a while, so don't hold up pop() meanwhile */
+    g_mutex_unlock(&prefetch->lock);
+    puzzle = tilepaint_puzzle_generate(size, &options, prefetch->cancellable);
+    g_mutex_lock(&prefetch->lock);
+
+    if (puzzle != NULL) {
+      gchar *json = tilepaint_generator_stats_to_json(&stats, size);
+
+      g_debug("Prefetched a %u×%u board: %s", size, size, json);
+      g_free(json);
+      g_queue_push_tail(prefetch_queue(prefetch, size), puzzle);
+      prefetch->cache_dirty = TRUE;
+    }
+  }
+
+  g_mutex_unlock(&prefetch->lock);
+
+  return NULL;
+}
+
+/* Boards are kept for the n_sizes sizes in `sizes`, which must be in
+ * increasing order, and for whichever size in between is being played. Boards
+ * saved in cache_path, if given, are ready straight away. No more are
+ * generated until tilepaint_prefetch_start() is called. */
+TilepaintPrefetch *tilepaint_prefetch_new(const guint *sizes, guint n_sizes,
+                                          guint preferred_size, guint depth,
+                                          const gchar *cache_path) {
+  TilepaintPrefetch *prefetch;
+  guint min_size, max_size;
+  guint i;
+
+  g_return_val_if_fail(sizes != NULL && n_sizes > 0 && sizes[0] > 0, NULL);
+  g_return_val_if_fail(depth > 0, NULL);
+
+  min_size = sizes[0];
+  max_size = sizes[n_sizes - 1];
+
+  prefetch = g_new0(TilepaintPrefetch, 1);
+  g_mutex_init(&prefetch->lock);
+  g_cond_init(&prefetch->cond);
+  prefetch->cancellable = g_cancellable_new();
+  prefetch->sizes = g_memdup2(sizes, n_sizes * sizeof(*sizes));
+  prefetch->n_sizes = n_sizes;
+  prefetch->min_size = min_size;
+  prefetch->max_size = max_size;
+  prefetch->preferred_size = CLAMP(preferred_size, min_size, max_size);
+  prefetch->depth = depth;
+
+  prefetch->queues = g_new(GQueue, max_size - min_size + 1);
+  for (i = 0; i <= max_size - min_size; i++)
+    g_queue_init(&prefetch->queues[i]);
+
+  if (cache_path != NULL) {
+    prefetch->cache_path = g_strdup(cache_path);
+    prefetch_load_cache(prefetch);
+  }
+
+  return prefetch;
+}
+
+void tilepaint_prefetch_start(TilepaintPrefetch *prefetch) {
+  g_return_if_fail(prefetch != NULL);
+  g_return_if_fail(prefetch->thread == NULL);
+
+  prefetch->thread =
+      g_thread_new("tilepaint-prefetch", prefetch_thread, prefetch);
+}
+
+void tilepaint_prefetch_free(TilepaintPrefetch *prefetch) {
+  guint i;
+
+  if (prefetch == NULL)
+    return;
+
+  /* Stop the worker, aborting any generation in progress */
+  g_mutex_lock(&prefetch->lock);
+  g_cancellable_cancel(prefetch->cancellable);
+  g_cond_signal(&prefetch->cond);
+  g_mutex_unlock(&prefetch->lock);
+
+  if (prefetch->thread != NULL)
+    g_thread_join(prefetch->thread);
+
+  /* Keep whatever is left over for next time */
+  if (prefetch->cache_path != NULL && prefetch->cache_dirty)
+    prefetch_save_cache(prefetch, prefetch_snapshot(prefetch));
+
+  for (i = 0; i <= prefetch->max_size - prefetch->min_size; i++)
+    g_queue_clear_full(&prefetch->queues[i],
+                       (GDestroyNotify)tilepaint_puzzle_free);
+  g_free(prefetch->queues);
+  g_free(prefetch->sizes);
+  g_free(prefetch->cache_path);
+
+  g_object_unref(prefetch->cancellable);
+  g_cond_clear(&prefetch->cond);
+  g_mutex_clear(&prefetch->lock);
+  g_free(prefetch);
+}
+
+/* Takes the first queued board of the given size and difficulty, if any. Must
+ * be called with the lock held. */
+static TilepaintPuzzle *prefetch_take(TilepaintPrefetch *prefetch, guint size,
+                                      TilepaintDifficulty difficulty) {
+  GQueue *queue = prefetch_queue(prefetch, size);
+  GList *l;
+
+  for (l = queue->head; l != NULL; l = l->next) {
+    if (puzzle_matches(l->data, difficulty)) {
+      TilepaintPuzzle *puzzle = l->data;
+
+      g_queue_delete_link(queue, l);
+      prefetch->cache_dirty = TRUE;
+      return puzzle;
+    }
+  }
+
+  return NULL;
+}
+
+/* Takes a ready board of the given size and difficulty, or returns NULL if
+ * there isn't one yet. Either way, the worker is told to prioritise this size
+ * and difficulty from now on. */
+TilepaintPuzzle *tilepaint_prefetch_pop(TilepaintPrefetch *prefetch,
+                                        guint size,
+                                        TilepaintDifficulty difficulty) {
+  TilepaintPuzzle *puzzle;
+
+  g_return_val_if_fail(prefetch != NULL, NULL);
+
+  g_mutex_lock(&prefetch->lock);
+
+  if (size < prefetch->min_size || size > prefetch->max_size) {
+    g_mutex_unlock(&prefetch->lock);
+    return NULL;
+  }
+
+  puzzle = prefetch_take(prefetch, size, difficulty);
+
+  prefetch->preferred_size = size;
+  prefetch->preferred_difficulty = difficulty;
+  g_cond_signal(&prefetch->cond);
+
+  g_mutex_unlock(&prefetch->lock);
+
+  return puzzle;
+}
+
+/* Takes a ready board of the given size and any difficulty, or returns NULL if
+ * there isn't one, without changing what the worker prioritises. This is for
+ * falling back on when a generation runs out of time, so it may be called from
+ * any thread. */
+TilepaintPuzzle *tilepaint_prefetch_steal(TilepaintPrefetch *prefetch,
+                                          guint size) {
+  TilepaintPuzzle *puzzle = NULL;
+
+  g_return_val_if_fail(prefetch != NULL, NULL);
+
+  g_mutex_lock(&prefetch->lock);
+
+  if (size >= prefetch->min_size && size <= prefetch->max_size) {
+    puzzle = prefetch_take(prefetch, size, TILEPAINT_DIFFICULTY_ANY);
+
+    /* Let the worker refill the queue */
+    if (puzzle != NULL)
+      g_cond_signal(&prefetch->cond);
+  }
+
+  g_mutex_unlock(&prefetch->lock);
+
+  return puzzle;
+}
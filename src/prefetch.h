@@ -0,0 +1,46 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEPAINT_PREFETCH_H
+#define TILEPAINT_PREFETCH_H
+
+#include <glib.h>
+
+#include "generator.h"
+
+G_BEGIN_DECLS
+
+/* Keeps ready-made boards for each size, refilled by a worker thread and
+ * optionally kept on disk between runs */
+typedef struct _TilepaintPrefetch TilepaintPrefetch;
+
+TilepaintPrefetch *tilepaint_prefetch_new(const guint *sizes, guint n_sizes,
+                                          guint preferred_size, guint depth,
+                                          const gchar *cache_path);
+void tilepaint_prefetch_start(TilepaintPrefetch *prefetch);
+void tilepaint_prefetch_free(TilepaintPrefetch *prefetch);
+TilepaintPuzzle *tilepaint_prefetch_pop(TilepaintPrefetch *prefetch,
+                                        guint size,
+                                        TilepaintDifficulty difficulty);
+TilepaintPuzzle *tilepaint_prefetch_steal(TilepaintPrefetch *prefetch,
+                                          guint size);
+
+G_END_DECLS
+
+#endif /* TILEPAINT_PREFETCH_H */
@@ -37,14 +37,8 @@ gboolean tilepaint_check_rule2(TilepaintApplication *tilepaint) {
   gboolean success = TRUE;
 
   for (int y = 0; y < tilepaint->board_size; y++) {
-    int count = 0;
-    for (int x = 0; x < tilepaint->board_size; x++) {
-      if (tilepaint->board[x][y].status & CELL_PAINTED) {
-        count++;
-      }
-    }
-
-    if (count != tilepaint->row_clues[y]) {
+    if (tilepaint_bitplane_row_count(&tilepaint->painted, y) !=
+        tilepaint->row_clues[y]) {
       success = FALSE;
     }
   }
@@ -59,14 +53,8 @@ gboolean tilepaint_check_rule3(TilepaintApplication *tilepaint) {
   gboolean success = TRUE;
 
   for (int x = 0; x < tilepaint->board_size; x++) {
-    int count = 0;
-    for (int y = 0; y < tilepaint->board_size; y++) {
-      if (tilepaint->board[x][y].status & CELL_PAINTED) {
-        count++;
-      }
-    }
-
-    if (count != tilepaint->col_clues[x]) {
+    if (tilepaint_bitplane_col_count(&tilepaint->painted, x) !=
+        tilepaint->col_clues[x]) {
       success = FALSE;
     }
   }
@@ -74,9 +62,28 @@ gboolean tilepaint_check_rule3(TilepaintApplication *tilepaint) {
   return success;
 }
 
+/* Counts the painted cells of every line afresh, and how many lines are
+ * wrong. Needed once a board and its clues are set up; every toggle of a
+ * cell keeps the counts from then on. */
+void tilepaint_count_lines(TilepaintApplication *tilepaint) {
+  tilepaint->n_wrong_lines = 0;
+
+  for (int i = 0; i < tilepaint->board_size; i++) {
+    tilepaint->row_counts[i] =
+        tilepaint_bitplane_row_count(&tilepaint->painted, i);
+    tilepaint->col_counts[i] =
+        tilepaint_bitplane_col_count(&tilepaint->painted, i);
+
+    tilepaint->n_wrong_lines +=
+        (tilepaint->row_counts[i] != tilepaint->row_clues[i]) +
+        (tilepaint->col_counts[i] != tilepaint->col_clues[i]);
+  }
+}
+
 gboolean tilepaint_check_win(TilepaintApplication *tilepaint) {
-  /* Check all rules (Rule 1 is now deprecated) */
-  if (tilepaint_check_rule2(tilepaint) && tilepaint_check_rule3(tilepaint)) {
+  /* Check all rules (Rule 1 is now deprecated). Rules 2 and 3 hold just when
+   * no line is wrong, which is kept count of as cells are painted. */
+  if (tilepaint->n_wrong_lines == 0) {
 
     /* Win! */
     tilepaint_disable_events(tilepaint);
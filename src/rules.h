@@ -29,6 +29,7 @@ gboolean tilepaint_check_rule1 (Tilepaint *tilepaint);
 gboolean tilepaint_check_rule2 (Tilepaint *tilepaint);
 gboolean tilepaint_check_rule3 (Tilepaint *tilepaint);
 gboolean tilepaint_check_win (Tilepaint *tilepaint);
+void tilepaint_count_lines (Tilepaint *tilepaint);
 
 G_END_DECLS
 
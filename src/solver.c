@@ -0,0 +1,1373 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "generator.h"
+#include "solver.h"
+
+/* Solver state is kept as packed 8-bit vectors: lanes [0, SOLVER_COLS) hold
+ * per-row values and lanes [SOLVER_COLS, SOLVER_LANES) per-column values, so
+ * that all 32 rows and 32 columns fit in two 32-byte registers. Unused lanes
+ * stay zero and never constrain the search. */
+#define SOLVER_COLS 32
+#define SOLVER_LANES (2 * SOLVER_COLS)
+
+G_STATIC_ASSERT(TILEPAINT_PUZZLE_MAX_SIZE <= SOLVER_COLS);
+
+typedef struct {
+  guint8 v[SOLVER_LANES];
+} SolverVec;
+
+/* Vector kernels used by the search. Each operates on all SOLVER_LANES lanes
+ * at once; clue sums never exceed TILEPAINT_PUZZLE_MAX_SIZE, so 8-bit lanes
+ * can't overflow. */
+typedef struct {
+  const gchar *name;
+  /* dst -= src, then return whether every lane of dst is >= bound */
+  gboolean (*sub_and_test_ge)(SolverVec *dst, const SolverVec *src,
+                              const SolverVec *bound);
+  /* Return whether every lane of a is <= b */
+  gboolean (*test_le)(const SolverVec *a, const SolverVec *b);
+  void (*add)(SolverVec *dst, const SolverVec *src);
+  void (*sub)(SolverVec *dst, const SolverVec *src);
+  gboolean (*is_zero)(const SolverVec *a);
+} SolverKernel;
+
+static gboolean scalar_sub_and_test_ge(SolverVec *dst, const SolverVec *src,
+                                       const SolverVec *bound) {
+  gboolean ok = TRUE;
+
+  for (guint i = 0; i < SOLVER_LANES; i++) {
+    dst->v[i] -= src->v[i];
+    if (dst->v[i] < bound->v[i])
+      ok = FALSE;
+  }
+
+  return ok;
+}
+
+static gboolean scalar_test_le(const SolverVec *a, const SolverVec *b) {
+  for (guint i = 0; i < SOLVER_LANES; i++) {
+    if (a->v[i] > b->v[i])
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void scalar_add(SolverVec *dst, const SolverVec *src) {
+  for (guint i = 0; i < SOLVER_LANES; i++)
+    dst->v[i] += src->v[i];
+}
+
+static void scalar_sub(SolverVec *dst, const SolverVec *src) {
+  for (guint i = 0; i < SOLVER_LANES; i++)
+    dst->v[i] -= src->v[i];
+}
+
+static gboolean scalar_is_zero(const SolverVec *a) {
+  for (guint i = 0; i < SOLVER_LANES; i++) {
+    if (a->v[i] != 0)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static const SolverKernel scalar_kernel = {
+    "scalar",       scalar_sub_and_test_ge, scalar_test_le, scalar_add,
+    scalar_sub,     scalar_is_zero,
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+#define SOLVER_HAVE_X86_KERNELS 1
+
+/* SSE2: four 16-byte chunks per vector. a >= b (unsigned) iff
+ * max(a, b) == a */
+__attribute__((target("sse2"))) static gboolean
+sse2_sub_and_test_ge(SolverVec *dst, const SolverVec *src,
+                     const SolverVec *bound) {
+  __m128i ge = _mm_set1_epi8(-1);
+
+  for (guint i = 0; i < SOLVER_LANES; i += 16) {
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst->v + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(bound->v + i));
+
+    d = _mm_sub_epi8(d, _mm_loadu_si128((const __m128i *)(src->v + i)));
+    _mm_storeu_si128((__m128i *)(dst->v + i), d);
+    ge = _mm_and_si128(ge, _mm_cmpeq_epi8(_mm_max_epu8(d, b), d));
+  }
+
+  return _mm_movemask_epi8(ge) == 0xffff;
+}
+
+__attribute__((target("sse2"))) static gboolean
+sse2_test_le(const SolverVec *a, const SolverVec *b) {
+  __m128i le = _mm_set1_epi8(-1);
+
+  for (guint i = 0; i < SOLVER_LANES; i += 16) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a->v + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b->v + i));
+
+    le = _mm_and_si128(le, _mm_cmpeq_epi8(_mm_max_epu8(va, vb), vb));
+  }
+
+  return _mm_movemask_epi8(le) == 0xffff;
+}
+
+__attribute__((target("sse2"))) static void sse2_add(SolverVec *dst,
+                                                     const SolverVec *src) {
+  for (guint i = 0; i < SOLVER_LANES; i += 16) {
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst->v + i));
+    __m128i s = _mm_loadu_si128((const __m128i *)(src->v + i));
+    _mm_storeu_si128((__m128i *)(dst->v + i), _mm_add_epi8(d, s));
+  }
+}
+
+__attribute__((target("sse2"))) static void sse2_sub(SolverVec *dst,
+                                                     const SolverVec *src) {
+  for (guint i = 0; i < SOLVER_LANES; i += 16) {
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst->v + i));
+    __m128i s = _mm_loadu_si128((const __m128i *)(src->v + i));
+    _mm_storeu_si128((__m128i *)(dst->v + i), _mm_sub_epi8(d, s));
+  }
+}
+
+__attribute__((target("sse2"))) static gboolean
+sse2_is_zero(const SolverVec *a) {
+  __m128i any = _mm_setzero_si128();
+
+  for (guint i = 0; i < SOLVER_LANES; i += 16)
+    any = _mm_or_si128(any, _mm_loadu_si128((const __m128i *)(a->v + i)));
+
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) ==
+         0xffff;
+}
+
+static const SolverKernel sse2_kernel = {
+    "sse2",   sse2_sub_and_test_ge, sse2_test_le, sse2_add,
+    sse2_sub, sse2_is_zero,
+};
+
+/* AVX2: two 32-byte registers per vector, the rows in one and the columns in
+ * the other */
+__attribute__((target("avx2"))) static gboolean
+avx2_sub_and_test_ge(SolverVec *dst, const SolverVec *src,
+                     const SolverVec *bound) {
+  __m256i d0 = _mm256_loadu_si256((const __m256i *)dst->v);
+  __m256i d1 = _mm256_loadu_si256((const __m256i *)(dst->v + 32));
+  __m256i b0 = _mm256_loadu_si256((const __m256i *)bound->v);
+  __m256i b1 = _mm256_loadu_si256((const __m256i *)(bound->v + 32));
+
+  d0 = _mm256_sub_epi8(d0, _mm256_loadu_si256((const __m256i *)src->v));
+  d1 = _mm256_sub_epi8(d1, _mm256_loadu_si256((const __m256i *)(src->v + 32)));
+  _mm256_storeu_si256((__m256i *)dst->v, d0);
+  _mm256_storeu_si256((__m256i *)(dst->v + 32), d1);
+
+  return _mm256_movemask_epi8(_mm256_and_si256(
+             _mm256_cmpeq_epi8(_mm256_max_epu8(d0, b0), d0),
+             _mm256_cmpeq_epi8(_mm256_max_epu8(d1, b1), d1))) == -1;
+}
+
+__attribute__((target("avx2"))) static gboolean
+avx2_test_le(const SolverVec *a, const SolverVec *b) {
+  __m256i a0 = _mm256_loadu_si256((const __m256i *)a->v);
+  __m256i a1 = _mm256_loadu_si256((const __m256i *)(a->v + 32));
+  __m256i b0 = _mm256_loadu_si256((const __m256i *)b->v);
+  __m256i b1 = _mm256_loadu_si256((const __m256i *)(b->v + 32));
+
+  return _mm256_movemask_epi8(_mm256_and_si256(
+             _mm256_cmpeq_epi8(_mm256_max_epu8(a0, b0), b0),
+             _mm256_cmpeq_epi8(_mm256_max_epu8(a1, b1), b1))) == -1;
+}
+
+__attribute__((target("avx2"))) static void avx2_add(SolverVec *dst,
+                                                     const SolverVec *src) {
+  for (guint i = 0; i < SOLVER_LANES; i += 32) {
+    __m256i d = _mm256_loadu_si256((const __m256i *)(dst->v + i));
+    __m256i s = _mm256_loadu_si256((const __m256i *)(src->v + i));
+    _mm256_storeu_si256((__m256i *)(dst->v + i), _mm256_add_epi8(d, s));
+  }
+}
+
+__attribute__((target("avx2"))) static void avx2_sub(SolverVec *dst,
+                                                     const SolverVec *src) {
+  for (guint i = 0; i < SOLVER_LANES; i += 32) {
+    __m256i d = _mm256_loadu_si256((const __m256i *)(dst->v + i));
+    __m256i s = _mm256_loadu_si256((const __m256i *)(src->v + i));
+    _mm256_storeu_si256((__m256i *)(dst->v + i), _mm256_sub_epi8(d, s));
+  }
+}
+
+__attribute__((target("avx2"))) static gboolean
+avx2_is_zero(const SolverVec *a) {
+  __m256i any = _mm256_or_si256(
+      _mm256_loadu_si256((const __m256i *)a->v),
+      _mm256_loadu_si256((const __m256i *)(a->v + 32)));
+
+  return _mm256_testz_si256(any, any);
+}
+
+static const SolverKernel avx2_kernel = {
+    "avx2",   avx2_sub_and_test_ge, avx2_test_le, avx2_add,
+    avx2_sub, avx2_is_zero,
+};
+#endif /* x86 */
+
+/* Pick the widest kernel the CPU supports. Done once per process. */
+static const SolverKernel *solver_kernel_get(void) {
+  static const SolverKernel *kernel = NULL;
+
+  if (g_once_init_enter(&kernel)) {
+    const SolverKernel *chosen = &scalar_kernel;
+
+#ifdef SOLVER_HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      chosen = &avx2_kernel;
+    else if (__builtin_cpu_supports("sse2"))
+      chosen = &sse2_kernel;
+#endif
+
+    g_debug("Using %s solver kernel", chosen->name);
+    g_once_init_leave(&kernel, chosen);
+  }
+
+  return kernel;
+}
+
+/* Transposition table for the plain search. Once the tiles before tile_idx
+ * are decided, what is left of the search depends only on tile_idx and the
+ * clues still needed (the cells left are fixed by tile_idx), so the number of
+ * solutions below one such state can be reused every time another assignment
+ * arrives at it. The table is a fixed number of two-way buckets; when both
+ * ways are taken, the entry that was cheaper to compute is replaced. */
+typedef struct {
+  SolverVec need;
+  guint32 tile_idx; /* plus 1, so that 0 marks an empty slot */
+  guint32 nodes;    /* nodes it took to count the solutions */
+  guint32 solutions;
+} SearchMemoEntry;
+
+#define SEARCH_MEMO_WAYS 2
+/* Buckets per tile, up to a maximum of about 2.5 MB per search */
+#define SEARCH_MEMO_BUCKETS_PER_TILE 64
+#define SEARCH_MEMO_MAX_BUCKETS (1u << 14)
+
+/* One tile being decided by the plain search, standing in for a call of a
+ * recursive function so that the search can stop after any node and carry on
+ * later. The stage says how far that call has got. */
+typedef enum {
+  SEARCH_ENTER,        /* not visited yet */
+  SEARCH_TRIED_EMPTY,  /* back from leaving the tile empty */
+  SEARCH_TRIED_PAINTED /* back from painting it, or it couldn't be painted */
+} SearchStage;
+
+typedef struct {
+  guint tile_idx;
+  SearchStage stage;
+  gboolean painted; /* whether the tile is taken off need */
+  guint solutions_before;
+  guint nodes_before;
+  SearchMemoEntry *bucket;
+} SearchFrame;
+
+/* Context for the plain search */
+typedef struct {
+  const SolverKernel *kernel;
+  guint num_tiles;
+  SolverVec *tile_map; /* tile_id -> cells of the tile in each row/col */
+  SolverVec need;      /* clue minus cells painted so far */
+  SolverVec remaining; /* cells left in unassigned tiles */
+  guint solutions_found;
+  guint nodes;
+  guint node_budget;
+
+  SearchFrame *stack; /* num_tiles + 1 frames, one per tile and the leaf */
+  guint depth;
+
+  SearchMemoEntry *memo; /* memo_mask + 1 buckets of SEARCH_MEMO_WAYS */
+  guint memo_mask;
+
+  TilepaintSolverStats stats;
+} SolverCtx;
+
+/* How many search nodes to visit between calls to should_abort */
+#define SOLVER_ABORT_INTERVAL 4096
+
+static SearchMemoEntry *search_memo_bucket(SolverCtx *ctx, guint tile_idx) {
+  guint64 hash = tile_idx;
+
+  for (guint i = 0; i < SOLVER_LANES; i += sizeof(guint64)) {
+    guint64 word;
+
+    memcpy(&word, ctx->need.v + i, sizeof(word));
+    hash = (hash ^ word) * G_GUINT64_CONSTANT(0x9e3779b97f4a7c15);
+  }
+
+  return &ctx->memo[((hash >> 32) & ctx->memo_mask) * SEARCH_MEMO_WAYS];
+}
+
+static void search_push(SolverCtx *ctx, guint tile_idx) {
+  SearchFrame *frame = &ctx->stack[ctx->depth++];
+
+  frame->tile_idx = tile_idx;
+  frame->stage = SEARCH_ENTER;
+  frame->painted = FALSE;
+}
+
+/* Visits the node on top of the stack. Returns FALSE if the node is finished
+ * with, and TRUE if its tile is still to be tried both ways. */
+static gboolean search_enter(SolverCtx *ctx, SearchFrame *frame) {
+  if (ctx->solutions_found > 1)
+    return FALSE;
+
+  if (++ctx->nodes > ctx->node_budget) {
+    /* Unwind as though the board were ambiguous; the caller knows why it
+     * stopped and can tell the two apart. */
+    ctx->solutions_found = 2;
+    return FALSE;
+  }
+
+  ctx->stats.max_depth = MAX(ctx->stats.max_depth, frame->tile_idx);
+
+  if (frame->tile_idx == ctx->num_tiles) {
+    /* All tiles assigned, verify all clues matched (pruning should have handled
+     * this, but check anyway) */
+    if (ctx->kernel->is_zero(&ctx->need))
+      ctx->solutions_found++;
+    return FALSE;
+  }
+
+  frame->bucket = search_memo_bucket(ctx, frame->tile_idx);
+  for (guint way = 0; way < SEARCH_MEMO_WAYS; way++) {
+    if (frame->bucket[way].tile_idx == frame->tile_idx + 1 &&
+        memcmp(&frame->bucket[way].need, &ctx->need, sizeof(SolverVec)) == 0) {
+      ctx->solutions_found += frame->bucket[way].solutions;
+      ctx->stats.memo_hits++;
+      return FALSE;
+    }
+  }
+
+  frame->solutions_before = ctx->solutions_found;
+  frame->nodes_before = ctx->nodes;
+
+  return TRUE;
+}
+
+/* Carries the search on until it is over or has visited `budget` more nodes.
+ * Returns whether it is over. */
+static gboolean search_step(SolverCtx *ctx, guint budget) {
+  const SolverKernel *k = ctx->kernel;
+  guint nodes_end = ctx->nodes + MIN(budget, G_MAXUINT - ctx->nodes);
+
+  while (ctx->depth > 0) {
+    SearchFrame *frame = &ctx->stack[ctx->depth - 1];
+    const SolverVec *tile = &ctx->tile_map[frame->tile_idx];
+    SearchMemoEntry *slot;
+
+    switch (frame->stage) {
+    case SEARCH_ENTER:
+      if (ctx->nodes == nodes_end)
+        return FALSE;
+
+      if (!search_enter(ctx, frame)) {
+        ctx->depth--;
+        break;
+      }
+
+      /* Try Unpainted (0): can the unassigned tiles still reach every clue? */
+      frame->stage = SEARCH_TRIED_EMPTY;
+      if (k->sub_and_test_ge(&ctx->remaining, tile, &ctx->need)) {
+        search_push(ctx, frame->tile_idx + 1);
+        break;
+      }
+
+      ctx->stats.shortfall_prunes++;
+      /* fall through */
+
+    case SEARCH_TRIED_EMPTY:
+      if (ctx->solutions_found > 1) {
+        k->add(&ctx->remaining, tile);
+        ctx->depth--;
+        break;
+      }
+
+      /* Try Painted (1): the tile must not exceed any clue. remaining already
+       * excludes this tile, which is exactly the state painting needs. */
+      frame->stage = SEARCH_TRIED_PAINTED;
+      if (k->test_le(tile, &ctx->need)) {
+        k->sub(&ctx->need, tile);
+        frame->painted = TRUE;
+        search_push(ctx, frame->tile_idx + 1);
+        break;
+      }
+
+      ctx->stats.overshoot_prunes++;
+      /* fall through */
+
+    case SEARCH_TRIED_PAINTED:
+    default:
+      /* Backtrack */
+      if (frame->painted)
+        k->add(&ctx->need, tile);
+      k->add(&ctx->remaining, tile);
+
+      /* Only 0, 1 or more matters, so the count is kept capped at 2. A search
+       * cut short by finding a second solution stores a count that may be too
+       * low, but then the search is over and the table is never read again. */
+      slot = frame->bucket[0].nodes <= frame->bucket[1].nodes
+                 ? &frame->bucket[0]
+                 : &frame->bucket[1];
+      slot->need = ctx->need;
+      slot->tile_idx = frame->tile_idx + 1;
+      slot->nodes = ctx->nodes - frame->nodes_before;
+      slot->solutions = MIN(ctx->solutions_found - frame->solutions_before, 2);
+      ctx->depth--;
+      break;
+    }
+  }
+
+  return TRUE;
+}
+
+static void search_init(SolverCtx *ctx, const TilepaintPuzzle *puzzle,
+                        guint node_budget) {
+  guint size = puzzle->size;
+
+  memset(ctx, 0, sizeof(*ctx));
+  ctx->kernel = solver_kernel_get();
+  ctx->num_tiles = puzzle->num_tiles;
+  ctx->tile_map = g_new0(SolverVec, puzzle->num_tiles);
+  ctx->node_budget = node_budget;
+
+  ctx->memo_mask = 1;
+  while (ctx->memo_mask + 1 <
+         MIN(puzzle->num_tiles * SEARCH_MEMO_BUCKETS_PER_TILE,
+             SEARCH_MEMO_MAX_BUCKETS))
+    ctx->memo_mask = 2 * ctx->memo_mask + 1;
+  ctx->memo =
+      g_new0(SearchMemoEntry, (ctx->memo_mask + 1) * SEARCH_MEMO_WAYS);
+
+  for (guint i = 0; i < size; i++) {
+    ctx->need.v[i] = puzzle->row_clues[i];
+    ctx->need.v[SOLVER_COLS + i] = puzzle->col_clues[i];
+  }
+
+  /* Populate maps */
+  for (guint x = 0; x < size; x++) {
+    for (guint y = 0; y < size; y++) {
+      int tid = puzzle->tile_ids[x * size + y];
+      ctx->tile_map[tid].v[y]++;
+      ctx->tile_map[tid].v[SOLVER_COLS + x]++;
+      ctx->remaining.v[y]++;
+      ctx->remaining.v[SOLVER_COLS + x]++;
+    }
+  }
+
+  ctx->stack = g_new(SearchFrame, puzzle->num_tiles + 1);
+  search_push(ctx, 0);
+}
+
+static void search_clear(SolverCtx *ctx) {
+  g_free(ctx->tile_map);
+  g_free(ctx->memo);
+  g_free(ctx->stack);
+}
+
+/* The propagating solver treats each row and column clue as a subset-sum over
+ * the undecided tiles crossing that line: a tile must be painted if the clue
+ * can't be reached without it, and must stay empty if it can't be reached
+ * with it. Lines are re-examined whenever one of their tiles is decided,
+ * until nothing changes, and only then does the search branch. */
+typedef struct {
+  guint16 tile;
+  guint8 cells; /* cells of the tile in the line */
+} LineEntry;
+
+typedef struct {
+  guint16 line;
+  guint8 cells;
+} TileEntry;
+
+typedef enum {
+  TILE_UNKNOWN = -1,
+  TILE_EMPTY = 0,
+  TILE_PAINTED = 1
+} TileState;
+
+/* One level of the propagating search, standing in for a call of a recursive
+ * function as SearchFrame does */
+typedef enum {
+  PROPAGATE_ENTER,   /* not visited yet */
+  PROPAGATE_BRANCHED /* back from trying the branch tile as value */
+} PropagateStage;
+
+typedef struct {
+  PropagateStage stage;
+  guint mark;        /* trail length on entry */
+  guint branch;      /* tile being tried both ways */
+  guint branch_mark; /* trail length before it was decided */
+  TileState value;
+} PropagateFrame;
+
+typedef struct {
+  guint n_lines; /* rows, then columns */
+  guint n_tiles;
+  guint *line_start; /* line l's tiles are line_entries[line_start[l]...] */
+  LineEntry *line_entries;
+  guint *tile_start; /* tile t's lines are tile_entries[tile_start[t]...] */
+  TileEntry *tile_entries;
+
+  guint *tile_cells; /* size of each tile */
+
+  gint8 *state; /* TileState of each tile */
+  gint *need;   /* clue minus the painted cells of each line */
+  gint *open;   /* cells of undecided tiles in each line */
+  guint *trail; /* decided tiles, in order, for undoing */
+  guint trail_len;
+
+  guint *queue; /* lines to re-examine, as a ring */
+  gboolean *queued;
+  guint queue_head;
+  guint queue_len;
+
+  guint solutions_found;
+  guint nodes;
+  guint node_budget;
+
+  PropagateFrame *stack; /* a frame per branch, plus the last level */
+  guint depth;
+
+  /* If set, the first solution found that differs from known is kept in
+   * witness, as a TileState per tile */
+  gint8 *known;
+  gint8 *witness;
+  gboolean witness_found;
+
+  TilepaintSolverStats stats;
+} Propagator;
+
+/* Bit s of a reach set is set if the tiles can cover exactly s cells. Lines
+ * are at most TILEPAINT_PUZZLE_MAX_SIZE long, so a guint64 holds every sum. */
+G_STATIC_ASSERT(TILEPAINT_PUZZLE_MAX_SIZE < 64);
+
+/* Whether some a in `before` and b in `after` have a + b == sum */
+static gboolean reach_sum(guint64 before, guint64 after, gint sum) {
+  for (gint a = 0; a <= sum && (before >> a) != 0; a++) {
+    if (((before >> a) & 1) && ((after >> (sum - a)) & 1))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static void propagator_enqueue(Propagator *p, guint line) {
+  if (p->queued[line])
+    return;
+
+  p->queued[line] = TRUE;
+  p->queue[(p->queue_head + p->queue_len++) % p->n_lines] = line;
+}
+
+static void propagator_assign(Propagator *p, guint tile, TileState value) {
+  p->state[tile] = value;
+  p->trail[p->trail_len++] = tile;
+
+  for (guint i = p->tile_start[tile]; i < p->tile_start[tile + 1]; i++) {
+    const TileEntry *entry = &p->tile_entries[i];
+
+    if (value == TILE_PAINTED)
+      p->need[entry->line] -= entry->cells;
+    p->open[entry->line] -= entry->cells;
+    propagator_enqueue(p, entry->line);
+  }
+}
+
+/* Undecides every tile decided since the trail was mark long */
+static void propagator_undo(Propagator *p, guint mark) {
+  while (p->trail_len > mark) {
+    guint tile = p->trail[--p->trail_len];
+
+    for (guint i = p->tile_start[tile]; i < p->tile_start[tile + 1]; i++) {
+      const TileEntry *entry = &p->tile_entries[i];
+
+      if (p->state[tile] == TILE_PAINTED)
+        p->need[entry->line] += entry->cells;
+      p->open[entry->line] += entry->cells;
+    }
+
+    p->state[tile] = TILE_UNKNOWN;
+  }
+}
+
+/* Forces what it can in one line. Returns FALSE if the clue can't be met. */
+static gboolean propagator_check_line(Propagator *p, guint line) {
+  guint64 prefix[TILEPAINT_PUZZLE_MAX_SIZE + 1];
+  guint64 suffix[TILEPAINT_PUZZLE_MAX_SIZE + 1];
+  const LineEntry *open[TILEPAINT_PUZZLE_MAX_SIZE];
+  gint need = p->need[line];
+  gboolean at_a_glance;
+  guint n_open = 0, i;
+
+  if (need < 0) {
+    p->stats.overshoot_prunes++;
+    return FALSE;
+  }
+
+  for (i = p->line_start[line]; i < p->line_start[line + 1]; i++) {
+    if (p->state[p->line_entries[i].tile] == TILE_UNKNOWN)
+      open[n_open++] = &p->line_entries[i];
+  }
+
+  prefix[0] = 1;
+  for (i = 0; i < n_open; i++)
+    prefix[i + 1] = prefix[i] | (prefix[i] << open[i]->cells);
+
+  if (((prefix[n_open] >> need) & 1) == 0) {
+    p->stats.shortfall_prunes++;
+    return FALSE;
+  }
+
+  suffix[n_open] = 1;
+  for (i = n_open; i-- > 0;)
+    suffix[i] = suffix[i + 1] | (suffix[i + 1] << open[i]->cells);
+
+  /* A line that must be left empty or painted in full is decided at a
+   * glance; anything else takes weighing the tiles against each other */
+  at_a_glance = need == 0 || need == p->open[line];
+
+  /* Forcing a tile doesn't change which sums the others can make, so every
+   * tile can be judged against the same prefix and suffix sets */
+  for (i = 0; i < n_open; i++) {
+    gint cells = open[i]->cells;
+    gboolean can_empty = reach_sum(prefix[i], suffix[i + 1], need);
+    gboolean can_paint =
+        cells <= need && reach_sum(prefix[i], suffix[i + 1], need - cells);
+
+    if (can_empty == can_paint)
+      continue;
+
+    /* Forcing a tile cuts off the other branch, by one rule or the other */
+    if (can_empty) {
+      p->stats.overshoot_prunes++;
+      propagator_assign(p, open[i]->tile, TILE_EMPTY);
+    } else {
+      p->stats.shortfall_prunes++;
+      propagator_assign(p, open[i]->tile, TILE_PAINTED);
+    }
+
+    if (!at_a_glance)
+      p->stats.subset_deductions++;
+  }
+
+  return TRUE;
+}
+
+/* Re-examines lines until none changes. Returns FALSE on a contradiction. */
+static gboolean propagator_propagate(Propagator *p) {
+  while (p->queue_len > 0) {
+    guint line = p->queue[p->queue_head];
+
+    p->queue_head = (p->queue_head + 1) % p->n_lines;
+    p->queue_len--;
+    p->queued[line] = FALSE;
+
+    if (!propagator_check_line(p, line)) {
+      while (p->queue_len > 0) {
+        p->queued[p->queue[p->queue_head]] = FALSE;
+        p->queue_head = (p->queue_head + 1) % p->n_lines;
+        p->queue_len--;
+      }
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/* How far a line is from being forced: it is forced once its undecided
+ * tiles must either all be painted or all be left empty */
+static gint propagator_slack(const Propagator *p, guint line) {
+  return MIN(p->need[line], p->open[line] - p->need[line]);
+}
+
+/* Picks the undecided tile that matters most to some line, as deciding it is
+ * most likely to force others. A tile matters to a line in proportion to how
+ * much of the line's slack it would use up, so tiles are compared by the least
+ * slack per cell over their lines, and larger tiles win ties. Returns n_tiles
+ * if every tile is decided. */
+static guint propagator_choose_tile(const Propagator *p) {
+  guint best = p->n_tiles;
+  gint best_slack = 1; /* best tile's slack per cell, as a fraction */
+  gint best_cells = 0;
+
+  for (guint t = 0; t < p->n_tiles; t++) {
+    gint slack = 1, cells = 0;
+
+    if (p->state[t] != TILE_UNKNOWN)
+      continue;
+
+    for (guint i = p->tile_start[t]; i < p->tile_start[t + 1]; i++) {
+      gint line_slack = propagator_slack(p, p->tile_entries[i].line);
+      gint line_cells = p->tile_entries[i].cells;
+
+      if (line_slack * cells < slack * line_cells) {
+        slack = line_slack;
+        cells = line_cells;
+      }
+    }
+
+    if (best == p->n_tiles || slack * best_cells < best_slack * cells ||
+        (slack * best_cells == best_slack * cells &&
+         p->tile_cells[t] > p->tile_cells[best])) {
+      best = t;
+      best_slack = slack;
+      best_cells = cells;
+    }
+  }
+
+  return best;
+}
+
+static void propagator_push(Propagator *p) {
+  p->stack[p->depth++].stage = PROPAGATE_ENTER;
+}
+
+/* Decides the frame's branch tile as its value, and goes down to try it */
+static void propagator_branch(Propagator *p, PropagateFrame *frame,
+                              TileState value) {
+  frame->stage = PROPAGATE_BRANCHED;
+  frame->value = value;
+  frame->branch_mark = p->trail_len;
+  propagator_assign(p, frame->branch, value);
+  propagator_push(p);
+}
+
+/* Carries the search on until it is over or has visited `budget` more nodes.
+ * Returns whether it is over. */
+static gboolean propagator_step(Propagator *p, guint budget) {
+  guint nodes_end = p->nodes + MIN(budget, G_MAXUINT - p->nodes);
+
+  while (p->depth > 0) {
+    PropagateFrame *frame = &p->stack[p->depth - 1];
+
+    switch (frame->stage) {
+    case PROPAGATE_ENTER:
+      if (p->nodes == nodes_end)
+        return FALSE;
+
+      frame->mark = p->trail_len;
+      p->stats.max_depth = MAX(p->stats.max_depth, p->depth - 1);
+
+      if (++p->nodes > p->node_budget) {
+        p->solutions_found = 2;
+        p->depth--;
+        break;
+      }
+
+      if (!propagator_propagate(p)) {
+        propagator_undo(p, frame->mark);
+        p->depth--;
+        break;
+      }
+
+      frame->branch = propagator_choose_tile(p);
+      if (frame->branch == p->n_tiles) {
+        /* Every line has been checked with no tiles left open, so every
+         * clue is met exactly */
+        p->solutions_found++;
+        if (p->known != NULL && !p->witness_found &&
+            memcmp(p->state, p->known, p->n_tiles) != 0) {
+          memcpy(p->witness, p->state, p->n_tiles);
+          p->witness_found = TRUE;
+        }
+        propagator_undo(p, frame->mark);
+        p->depth--;
+        break;
+      }
+
+      /* Stuck: try both ways */
+      propagator_branch(p, frame, TILE_PAINTED);
+      break;
+
+    case PROPAGATE_BRANCHED:
+    default:
+      propagator_undo(p, frame->branch_mark);
+
+      if (p->solutions_found > 1 || frame->value == TILE_EMPTY) {
+        propagator_undo(p, frame->mark);
+        p->depth--;
+        break;
+      }
+
+      propagator_branch(p, frame, TILE_EMPTY);
+      break;
+    }
+  }
+
+  return TRUE;
+}
+
+/* If find_witness is set, the search also looks for a solution other than
+ * puzzle->solution */
+static void propagator_init(Propagator *p, const TilepaintPuzzle *puzzle,
+                            guint node_budget, gboolean find_witness) {
+  guint size = puzzle->size;
+  guint n_lines = 2 * size;
+  guint n_tiles = puzzle->num_tiles;
+  guint8 *line_cells = g_new0(guint8, n_tiles);
+  guint *tile_fill;
+  guint t, l, i;
+
+  memset(p, 0, sizeof(*p));
+  p->n_lines = n_lines;
+  p->n_tiles = n_tiles;
+  p->node_budget = node_budget;
+
+  /* A line crosses at most size tiles */
+  p->line_start = g_new(guint, n_lines + 1);
+  p->line_entries = g_new(LineEntry, n_lines * size);
+  p->tile_start = g_new0(guint, n_tiles + 1);
+
+  /* Count each tile's cells in each line, rows first... */
+  for (l = 0, i = 0; l < n_lines; l++) {
+    guint first = i;
+
+    p->line_start[l] = i;
+
+    for (guint j = 0; j < size; j++) {
+      guint cell = l < size ? j * size + l : (l - size) * size + j;
+
+      t = puzzle->tile_ids[cell];
+      if (line_cells[t]++ == 0)
+        p->line_entries[i++].tile = t;
+    }
+
+    for (guint e = first; e < i; e++) {
+      t = p->line_entries[e].tile;
+      p->line_entries[e].cells = line_cells[t];
+      line_cells[t] = 0;
+      p->tile_start[t + 1]++;
+    }
+  }
+  p->line_start[n_lines] = i;
+
+  /* ...and index the same entries by tile */
+  for (t = 0; t < n_tiles; t++)
+    p->tile_start[t + 1] += p->tile_start[t];
+
+  p->tile_entries = g_new(TileEntry, i);
+  tile_fill = g_new(guint, n_tiles);
+  memcpy(tile_fill, p->tile_start, n_tiles * sizeof(guint));
+
+  for (l = 0; l < n_lines; l++) {
+    for (i = p->line_start[l]; i < p->line_start[l + 1]; i++) {
+      t = p->line_entries[i].tile;
+      p->tile_entries[tile_fill[t]++] =
+          (TileEntry){l, p->line_entries[i].cells};
+    }
+  }
+
+  p->tile_cells = g_new0(guint, n_tiles);
+  for (i = 0; i < size * size; i++)
+    p->tile_cells[puzzle->tile_ids[i]]++;
+
+  g_free(tile_fill);
+  g_free(line_cells);
+
+  p->state = g_new(gint8, n_tiles);
+  memset(p->state, TILE_UNKNOWN, n_tiles);
+  p->need = g_new(gint, n_lines);
+  p->open = g_new(gint, n_lines);
+  for (l = 0; l < n_lines; l++)
+    p->open[l] = size;
+  for (l = 0; l < size; l++) {
+    p->need[l] = puzzle->row_clues[l];
+    p->need[size + l] = puzzle->col_clues[l];
+  }
+  p->trail = g_new(guint, n_tiles);
+
+  p->queue = g_new(guint, n_lines);
+  p->queued = g_new0(gboolean, n_lines);
+  for (l = 0; l < n_lines; l++)
+    propagator_enqueue(p, l);
+
+  if (find_witness) {
+    gint8 *known = g_new(gint8, n_tiles);
+
+    for (i = 0; i < size * size; i++)
+      known[puzzle->tile_ids[i]] =
+          puzzle->solution[i] ? TILE_PAINTED : TILE_EMPTY;
+    p->known = known;
+    p->witness = g_new(gint8, n_tiles);
+  }
+
+  p->stack = g_new(PropagateFrame, n_tiles + 1);
+  propagator_push(p);
+}
+
+static void propagator_clear(Propagator *p) {
+  g_free(p->line_start);
+  g_free(p->line_entries);
+  g_free(p->tile_start);
+  g_free(p->tile_entries);
+  g_free(p->tile_cells);
+  g_free(p->state);
+  g_free(p->need);
+  g_free(p->open);
+  g_free(p->trail);
+  g_free(p->queue);
+  g_free(p->queued);
+  g_free(p->stack);
+  g_free(p->known);
+  g_free(p->witness);
+}
+
+/* The meet-in-the-middle solver splits the tiles into two halves and lists
+ * every way of painting the first half without overshooting a clue, keyed on
+ * the cells it paints in each row and column. Each way of painting the second
+ * half then needs the first half to paint exactly the rest of every clue,
+ * which is a single lookup. This costs about 2^(n/2) per half rather than
+ * 2^n, at the price of keeping the first half's sums in memory. */
+typedef struct {
+  guint n_lines;
+  const guint8 *tile_lines; /* n_lines cells per tile */
+  const guint8 *clues;
+  guint8 *sums; /* cells painted so far in each line */
+  guint8 *left; /* cells in each line not yet decided in this half, plus
+                 * every cell of the other half */
+
+  /* Open-addressed table of the first half's sums, never more than half
+   * full. Slots hold an index plus 1 into keys and counts, or 0 if empty. */
+  guint *slots;
+  guint slot_mask;
+  guint8 *keys;   /* n_lines bytes per entry */
+  guint8 *counts; /* ways to reach each entry, capped at 2 */
+  guint n_entries;
+
+  guint solutions_found;
+  guint nodes;
+  guint node_budget;
+  gboolean aborted;
+  TilepaintSolverAbortFunc should_abort;
+  gpointer abort_data;
+
+  TilepaintSolverStats stats;
+} MeetCtx;
+
+/* Most first-half sums kept at once, about 16 MB for 30×30 boards */
+#define MEET_MAX_ENTRIES (1u << 18)
+#define MEET_MIN_SLOTS 256
+
+static guint *meet_lookup(MeetCtx *ctx, const guint8 *key) {
+  guint32 hash = 2166136261u;
+  guint i;
+
+  for (i = 0; i < ctx->n_lines; i++)
+    hash = (hash ^ key[i]) * 16777619u;
+
+  for (i = hash & ctx->slot_mask;; i = (i + 1) & ctx->slot_mask) {
+    guint entry = ctx->slots[i];
+
+    if (entry == 0 ||
+        memcmp(&ctx->keys[(entry - 1) * ctx->n_lines], key, ctx->n_lines) == 0)
+      return &ctx->slots[i];
+  }
+}
+
+/* Doubles the table, keeping it at most half full */
+static void meet_grow(MeetCtx *ctx) {
+  guint old_mask = ctx->slot_mask;
+  guint *old_slots = ctx->slots;
+
+  ctx->slot_mask = 2 * old_mask + 1;
+  ctx->slots = g_new0(guint, ctx->slot_mask + 1);
+  ctx->keys = g_renew(guint8, ctx->keys,
+                      (gsize)(ctx->slot_mask + 1) / 2 * ctx->n_lines);
+  ctx->counts = g_renew(guint8, ctx->counts, (ctx->slot_mask + 1) / 2);
+
+  for (guint i = 0; i <= old_mask; i++) {
+    if (old_slots[i] != 0)
+      *meet_lookup(ctx, &ctx->keys[(old_slots[i] - 1) * ctx->n_lines]) =
+          old_slots[i];
+  }
+  g_free(old_slots);
+}
+
+static void meet_insert(MeetCtx *ctx) {
+  guint *slot = meet_lookup(ctx, ctx->sums);
+
+  if (*slot != 0) {
+    ctx->counts[*slot - 1] = MIN(ctx->counts[*slot - 1] + 1, 2);
+    return;
+  }
+
+  if (ctx->n_entries == (ctx->slot_mask + 1) / 2) {
+    if (ctx->n_entries == MEET_MAX_ENTRIES) {
+      /* Out of room: give up as though over budget */
+      ctx->aborted = TRUE;
+      return;
+    }
+
+    meet_grow(ctx);
+    slot = meet_lookup(ctx, ctx->sums);
+  }
+
+  memcpy(&ctx->keys[ctx->n_entries * ctx->n_lines], ctx->sums, ctx->n_lines);
+  ctx->counts[ctx->n_entries] = 1;
+  *slot = ++ctx->n_entries;
+}
+
+static gboolean meet_visit(MeetCtx *ctx) {
+  if (++ctx->nodes > ctx->node_budget ||
+      (ctx->nodes % SOLVER_ABORT_INTERVAL == 0 && ctx->should_abort != NULL &&
+       ctx->should_abort(ctx->abort_data)))
+    ctx->aborted = TRUE;
+
+  return !ctx->aborted && ctx->solutions_found < 2;
+}
+
+/* Goes through every painting of tiles [tile, end). With match unset, each is
+ * added to the table; with it set, each is matched against the table. */
+static void meet_search(MeetCtx *ctx, guint tile, guint start, guint end,
+                        gboolean match) {
+  const guint8 *lines;
+  gboolean can_empty = TRUE, can_paint = TRUE;
+  guint l;
+
+  if (!meet_visit(ctx))
+    return;
+
+  ctx->stats.max_depth = MAX(ctx->stats.max_depth, tile - start);
+
+  if (tile == end && !match) {
+    meet_insert(ctx);
+    return;
+  }
+
+  if (tile == end) {
+    guint8 rest[2 * TILEPAINT_PUZZLE_MAX_SIZE];
+    guint entry;
+
+    for (l = 0; l < ctx->n_lines; l++)
+      rest[l] = ctx->clues[l] - ctx->sums[l];
+
+    entry = *meet_lookup(ctx, rest);
+    if (entry != 0)
+      ctx->solutions_found += ctx->counts[entry - 1];
+    return;
+  }
+
+  /* Leaving the tile empty must leave enough cells to meet every clue, and
+   * painting it mustn't overshoot one */
+  lines = &ctx->tile_lines[tile * ctx->n_lines];
+  for (l = 0; l < ctx->n_lines; l++) {
+    ctx->left[l] -= lines[l];
+    if (ctx->sums[l] + ctx->left[l] < ctx->clues[l])
+      can_empty = FALSE;
+    if (ctx->sums[l] + lines[l] > ctx->clues[l])
+      can_paint = FALSE;
+  }
+
+  if (can_empty)
+    meet_search(ctx, tile + 1, start, end, match);
+  else
+    ctx->stats.shortfall_prunes++;
+
+  if (can_paint) {
+    for (l = 0; l < ctx->n_lines; l++)
+      ctx->sums[l] += lines[l];
+    meet_search(ctx, tile + 1, start, end, match);
+    for (l = 0; l < ctx->n_lines; l++)
+      ctx->sums[l] -= lines[l];
+  } else {
+    ctx->stats.overshoot_prunes++;
+  }
+
+  for (l = 0; l < ctx->n_lines; l++)
+    ctx->left[l] += lines[l];
+}
+
+static guint meet_count(const TilepaintPuzzle *puzzle, guint node_budget,
+                        TilepaintSolverAbortFunc should_abort,
+                        gpointer abort_data, TilepaintSolverStats *stats) {
+  guint size = puzzle->size;
+  guint n_tiles = puzzle->num_tiles;
+  guint8 clues[2 * TILEPAINT_PUZZLE_MAX_SIZE];
+  guint8 sums[2 * TILEPAINT_PUZZLE_MAX_SIZE] = {0};
+  guint8 left[2 * TILEPAINT_PUZZLE_MAX_SIZE];
+  guint8 *tile_lines;
+  MeetCtx ctx;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.n_lines = 2 * size;
+  ctx.clues = clues;
+  ctx.sums = sums;
+  ctx.left = left;
+  ctx.node_budget = node_budget;
+  ctx.should_abort = should_abort;
+  ctx.abort_data = abort_data;
+
+  memcpy(clues, puzzle->row_clues, size);
+  memcpy(clues + size, puzzle->col_clues, size);
+
+  tile_lines = g_new0(guint8, n_tiles * ctx.n_lines);
+  for (guint x = 0; x < size; x++) {
+    for (guint y = 0; y < size; y++) {
+      guint8 *lines = &tile_lines[puzzle->tile_ids[x * size + y] * ctx.n_lines];
+
+      lines[y]++;
+      lines[size + x]++;
+    }
+  }
+  ctx.tile_lines = tile_lines;
+
+  ctx.slot_mask = MEET_MIN_SLOTS - 1;
+  ctx.slots = g_new0(guint, MEET_MIN_SLOTS);
+  ctx.keys = g_new(guint8, MEET_MIN_SLOTS / 2 * ctx.n_lines);
+  ctx.counts = g_new(guint8, MEET_MIN_SLOTS / 2);
+
+  /* Tile ids follow the board's raster order, so each half is a compact
+   * region and most columns lie wholly in one of them */
+  memset(left, size, ctx.n_lines);
+  meet_search(&ctx, 0, 0, n_tiles / 2, FALSE);
+  memset(left, size, ctx.n_lines);
+  meet_search(&ctx, n_tiles / 2, n_tiles / 2, n_tiles, TRUE);
+
+  ctx.stats.nodes = ctx.nodes;
+  if (stats != NULL)
+    tilepaint_solver_stats_add(stats, &ctx.stats);
+
+  g_free(tile_lines);
+  g_free(ctx.slots);
+  g_free(ctx.keys);
+  g_free(ctx.counts);
+
+  return ctx.aborted ? 2 : MIN(ctx.solutions_found, 2);
+}
+
+void tilepaint_solver_stats_add(TilepaintSolverStats *stats,
+                                const TilepaintSolverStats *other) {
+  stats->nodes += other->nodes;
+  stats->memo_hits += other->memo_hits;
+  stats->overshoot_prunes += other->overshoot_prunes;
+  stats->shortfall_prunes += other->shortfall_prunes;
+  stats->subset_deductions += other->subset_deductions;
+  stats->max_depth = MAX(stats->max_depth, other->max_depth);
+}
+
+struct _TilepaintSolver {
+  TilepaintSolverEngine engine;
+  const TilepaintPuzzle *puzzle;
+  gboolean finished;
+
+  SolverCtx search;      /* for TILEPAINT_SOLVER_SEARCH */
+  Propagator propagator; /* for TILEPAINT_SOLVER_PROPAGATE */
+};
+
+static TilepaintSolver *solver_new(const TilepaintPuzzle *puzzle,
+                                   TilepaintSolverEngine engine,
+                                   guint node_budget, gboolean find_witness) {
+  TilepaintSolver *solver = g_new0(TilepaintSolver, 1);
+
+  solver->engine = engine;
+  solver->puzzle = puzzle;
+
+  if (engine == TILEPAINT_SOLVER_SEARCH)
+    search_init(&solver->search, puzzle, node_budget);
+  else
+    propagator_init(&solver->propagator, puzzle, node_budget, find_witness);
+
+  return solver;
+}
+
+/* Sets up a search of the puzzle's solutions that is run by calling
+ * tilepaint_solver_step() until it finishes, and that can be dropped at any
+ * point between steps. The puzzle mustn't change or be freed meanwhile. The
+ * meet-in-the-middle engine can only be run by tilepaint_solver_count(). */
+TilepaintSolver *tilepaint_solver_new(const TilepaintPuzzle *puzzle,
+                                      TilepaintSolverEngine engine,
+                                      guint node_budget) {
+  g_return_val_if_fail(puzzle != NULL, NULL);
+  g_return_val_if_fail(engine == TILEPAINT_SOLVER_SEARCH ||
+                           engine == TILEPAINT_SOLVER_PROPAGATE,
+                       NULL);
+
+  return solver_new(puzzle, engine, node_budget, FALSE);
+}
+
+/* As tilepaint_solver_new() with the propagating engine, also looking for a
+ * solution other than puzzle->solution, as tilepaint_solver_find_witness()
+ * does */
+TilepaintSolver *tilepaint_solver_new_witness(const TilepaintPuzzle *puzzle,
+                                              guint node_budget) {
+  g_return_val_if_fail(puzzle != NULL, NULL);
+
+  return solver_new(puzzle, TILEPAINT_SOLVER_PROPAGATE, node_budget, TRUE);
+}
+
+void tilepaint_solver_free(TilepaintSolver *solver) {
+  if (solver == NULL)
+    return;
+
+  if (solver->engine == TILEPAINT_SOLVER_SEARCH)
+    search_clear(&solver->search);
+  else
+    propagator_clear(&solver->propagator);
+
+  g_free(solver);
+}
+
+/* Visits up to `budget` more search nodes. Returns TRUE once the search is
+ * over, after which the results can be read. */
+gboolean tilepaint_solver_step(TilepaintSolver *solver, guint budget) {
+  g_return_val_if_fail(solver != NULL, TRUE);
+
+  if (solver->finished)
+    return TRUE;
+
+  if (solver->engine == TILEPAINT_SOLVER_SEARCH)
+    solver->finished = search_step(&solver->search, budget);
+  else
+    solver->finished = propagator_step(&solver->propagator, budget);
+
+  return solver->finished;
+}
+
+/* The number of solutions of a finished search, capped at 2 as in
+ * tilepaint_solver_count() */
+guint tilepaint_solver_get_n_solutions(TilepaintSolver *solver) {
+  g_return_val_if_fail(solver != NULL, 0);
+  g_return_val_if_fail(solver->finished, 2);
+
+  if (solver->engine == TILEPAINT_SOLVER_SEARCH)
+    return MIN(solver->search.solutions_found, 2);
+
+  return MIN(solver->propagator.solutions_found, 2);
+}
+
+/* Returns TRUE and writes the other solution to witness, laid out like
+ * puzzle->solution, if a search from tilepaint_solver_new_witness() has found
+ * one. Can be called before the search is over. */
+gboolean tilepaint_solver_get_witness(TilepaintSolver *solver,
+                                      guchar *witness) {
+  const Propagator *p;
+  guint n_cells;
+
+  g_return_val_if_fail(solver != NULL, FALSE);
+  g_return_val_if_fail(witness != NULL, FALSE);
+
+  p = &solver->propagator;
+  if (solver->engine != TILEPAINT_SOLVER_PROPAGATE || !p->witness_found)
+    return FALSE;
+
+  n_cells = solver->puzzle->size * solver->puzzle->size;
+  for (guint i = 0; i < n_cells; i++)
+    witness[i] = p->witness[solver->puzzle->tile_ids[i]] == TILE_PAINTED;
+
+  return TRUE;
+}
+
+/* Adds the work done so far to stats */
+void tilepaint_solver_get_stats(TilepaintSolver *solver,
+                                TilepaintSolverStats *stats) {
+  TilepaintSolverStats own;
+
+  g_return_if_fail(solver != NULL);
+  g_return_if_fail(stats != NULL);
+
+  if (solver->engine == TILEPAINT_SOLVER_SEARCH) {
+    own = solver->search.stats;
+    own.nodes = solver->search.nodes;
+  } else {
+    own = solver->propagator.stats;
+    own.nodes = solver->propagator.nodes;
+  }
+
+  tilepaint_solver_stats_add(stats, &own);
+}
+
+/* Steps a search through to the end, polling should_abort in between. Returns
+ * FALSE if it was aborted. */
+static gboolean solver_run(TilepaintSolver *solver,
+                           TilepaintSolverAbortFunc should_abort,
+                           gpointer abort_data) {
+  while (!tilepaint_solver_step(solver, SOLVER_ABORT_INTERVAL)) {
+    if (should_abort != NULL && should_abort(abort_data))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+guint tilepaint_solver_count(const TilepaintPuzzle *puzzle,
+                             TilepaintSolverEngine engine, guint node_budget,
+                             TilepaintSolverAbortFunc should_abort,
+                             gpointer abort_data, TilepaintSolverStats *stats) {
+  TilepaintSolver *solver;
+  guint count = 2; /* if aborted */
+
+  g_return_val_if_fail(puzzle != NULL, 0);
+
+  if (engine == TILEPAINT_SOLVER_MEET_IN_MIDDLE)
+    return meet_count(puzzle, node_budget, should_abort, abort_data, stats);
+
+  solver = tilepaint_solver_new(puzzle, engine, node_budget);
+  g_return_val_if_fail(solver != NULL, 0);
+
+  if (solver_run(solver, should_abort, abort_data))
+    count = tilepaint_solver_get_n_solutions(solver);
+  if (stats != NULL)
+    tilepaint_solver_get_stats(solver, stats);
+  tilepaint_solver_free(solver);
+
+  return count;
+}
+
+gboolean tilepaint_solver_find_witness(const TilepaintPuzzle *puzzle,
+                                       guint node_budget,
+                                       TilepaintSolverAbortFunc should_abort,
+                                       gpointer abort_data,
+                                       TilepaintSolverStats *stats,
+                                       guchar *witness, guint *n_solutions) {
+  TilepaintSolver *solver;
+  gboolean witness_found;
+  guint count = 2; /* if aborted */
+
+  g_return_val_if_fail(puzzle != NULL, FALSE);
+  g_return_val_if_fail(witness != NULL, FALSE);
+
+  solver = tilepaint_solver_new_witness(puzzle, node_budget);
+  if (solver_run(solver, should_abort, abort_data))
+    count = tilepaint_solver_get_n_solutions(solver);
+  witness_found = tilepaint_solver_get_witness(solver, witness);
+  if (stats != NULL)
+    tilepaint_solver_get_stats(solver, stats);
+  tilepaint_solver_free(solver);
+
+  if (n_solutions != NULL)
+    *n_solutions = count;
+
+  return witness_found;
+}
@@ -0,0 +1,88 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEPAINT_SOLVER_H
+#define TILEPAINT_SOLVER_H
+
+#include <glib.h>
+
+#include "generator.h"
+
+G_BEGIN_DECLS
+
+/* Polled during the search; returning TRUE abandons it */
+typedef gboolean (*TilepaintSolverAbortFunc)(gpointer user_data);
+
+typedef enum {
+  /* Depth-first search over the tiles in order, pruned by running row and
+   * column sums */
+  TILEPAINT_SOLVER_SEARCH,
+  /* Forces tiles from each row and column clue to a fixed point, and only
+   * branches when that gets stuck */
+  TILEPAINT_SOLVER_PROPAGATE,
+  /* Lists the row and column sums of every painting of half the tiles, then
+   * looks up what each painting of the other half still needs */
+  TILEPAINT_SOLVER_MEET_IN_MIDDLE,
+} TilepaintSolverEngine;
+
+/* Adds other's counts into stats */
+void tilepaint_solver_stats_add(TilepaintSolverStats *stats,
+                                const TilepaintSolverStats *other);
+
+/* Counts the solutions of a puzzle's tiles and clues, stopping at 2. A search
+ * that visits more than node_budget nodes or is aborted also returns 2. If
+ * stats isn't NULL, the work done is added to it. */
+guint tilepaint_solver_count(const TilepaintPuzzle *puzzle,
+                             TilepaintSolverEngine engine, guint node_budget,
+                             TilepaintSolverAbortFunc should_abort,
+                             gpointer abort_data, TilepaintSolverStats *stats);
+
+/* Counts solutions as tilepaint_solver_count() does with the propagating
+ * engine, and also looks for a solution other than puzzle->solution. Returns
+ * TRUE if one was found, in which case it is written to witness, laid out like
+ * puzzle->solution. The count, if wanted, is stored in n_solutions. */
+gboolean tilepaint_solver_find_witness(const TilepaintPuzzle *puzzle,
+                                       guint node_budget,
+                                       TilepaintSolverAbortFunc should_abort,
+                                       gpointer abort_data,
+                                       TilepaintSolverStats *stats,
+                                       guchar *witness, guint *n_solutions);
+
+/* A search that runs a slice at a time, so that it can be interleaved with
+ * other work, such as a main loop, and dropped cleanly at any point. The
+ * search keeps its own stack rather than recursing, so its depth isn't
+ * bounded by the C stack either. */
+typedef struct _TilepaintSolver TilepaintSolver;
+
+TilepaintSolver *tilepaint_solver_new(const TilepaintPuzzle *puzzle,
+                                      TilepaintSolverEngine engine,
+                                      guint node_budget);
+TilepaintSolver *tilepaint_solver_new_witness(const TilepaintPuzzle *puzzle,
+                                              guint node_budget);
+void tilepaint_solver_free(TilepaintSolver *solver);
+gboolean tilepaint_solver_step(TilepaintSolver *solver, guint budget);
+guint tilepaint_solver_get_n_solutions(TilepaintSolver *solver);
+gboolean tilepaint_solver_get_witness(TilepaintSolver *solver,
+                                      guchar *witness);
+void tilepaint_solver_get_stats(TilepaintSolver *solver,
+                                TilepaintSolverStats *stats);
+
+G_END_DECLS
+
+#endif /* TILEPAINT_SOLVER_H */
@@ -0,0 +1,371 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* tilepaint-gen: generates verified unique puzzles in bulk, without a
+ * display. Puzzle i is generated from seed seed-start + i, so any puzzle in
+ * the output can be regenerated on its own. Each is written as one line:
+ *
+ *   <size> <seed> <tile ids> <row clues> <column clues> <solution>
+ *
+ * Tile ids are comma-separated and row-major, the clues are comma-separated,
+ * and the solution is row-major with 1 for each painted cell. Lines are
+ * written in seed order regardless of which thread finished first.
+ *
+ * With --pack, the puzzles are instead written, in the same order, to a
+ * binary puzzle pack which the game can load boards from directly, each filed
+ * under the difficulty the generator rated it.
+ *
+ * With --difficulty, every puzzle is generated to the given difficulty (easy,
+ * medium or hard) where the board size allows it.
+ *
+ * With --dedup, a puzzle equal to, or a rotation or mirror image of, one
+ * already in the given fingerprint index, or earlier in this run, is dropped
+ * rather than written, and the index is saved with the new puzzles added.
+ * Dropped puzzles still use up their seeds, so fewer than --count may be
+ * written.
+ *
+ * With --stats, the work the generator did, summed over every puzzle, is
+ * written as a JSON object: attempts, solver nodes and prunes, and the time
+ * spent in each phase. */
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "generator.h"
+#include "pack.h"
+
+/* How far ahead of the oldest unwritten puzzle each thread may run */
+#define REORDER_WINDOW_PER_THREAD 64
+
+typedef struct {
+  guint size;
+  guint64 count;
+  guint64 seed_start;
+  TilepaintDifficulty difficulty;
+  FILE *output;              /* for text output */
+  TilepaintPackWriter *pack; /* for pack output */
+  TilepaintFingerprintIndex *index; /* NULL to keep duplicates */
+  guint64 n_duplicates;
+
+  GMutex lock;
+  GCond cond;
+  guint64 next_index;   /* next puzzle to hand out */
+  guint64 next_written; /* next puzzle to write */
+  guint window;
+  TilepaintPuzzle **pending; /* puzzles waiting to be written, by index */
+  guint64 *fingerprints;     /* of the pending puzzles, if deduplicating */
+  TilepaintGeneratorStats stats;
+} GenJob;
+
+static gchar *format_puzzle(const TilepaintPuzzle *puzzle, guint seed) {
+  GString *line = g_string_new(NULL);
+  guint size = puzzle->size;
+  guint x, y;
+
+  g_string_append_printf(line, "%u %u ", size, seed);
+
+  for (y = 0; y < size; y++) {
+    for (x = 0; x < size; x++) {
+      g_string_append_printf(line, (x == 0 && y == 0) ? "%u" : ",%u",
+                             puzzle->tile_ids[x * size + y]);
+    }
+  }
+
+  g_string_append_c(line, ' ');
+  for (y = 0; y < size; y++)
+    g_string_append_printf(line, y == 0 ? "%u" : ",%u", puzzle->row_clues[y]);
+
+  g_string_append_c(line, ' ');
+  for (x = 0; x < size; x++)
+    g_string_append_printf(line, x == 0 ? "%u" : ",%u", puzzle->col_clues[x]);
+
+  g_string_append_c(line, ' ');
+  for (y = 0; y < size; y++) {
+    for (x = 0; x < size; x++)
+      g_string_append_c(line, puzzle->solution[x * size + y] ? '1' : '0');
+  }
+
+  g_string_append_c(line, '\n');
+
+  return g_string_free(line, FALSE);
+}
+
+static gpointer gen_thread(gpointer user_data) {
+  GenJob *job = user_data;
+  TilepaintGeneratorStats stats = {0};
+
+  g_mutex_lock(&job->lock);
+
+  while (job->next_index < job->count) {
+    guint64 index = job->next_index++;
+    TilepaintGeneratorOptions options = {0, 1, &stats, job->difficulty};
+    TilepaintPuzzle *puzzle;
+    guint64 fingerprint;
+
+    /* Don't get too far ahead of a puzzle that is taking a long time */
+    while (index >= job->next_written + job->window)
+      g_cond_wait(&job->cond, &job->lock);
+
+    g_mutex_unlock(&job->lock);
+
+    options.seed = job->seed_start + index;
+    puzzle = tilepaint_puzzle_generate(job->size, &options, NULL);
+    fingerprint =
+        job->index != NULL ? tilepaint_puzzle_fingerprint(puzzle) : 0;
+
+    g_mutex_lock(&job->lock);
+
+    job->pending[index % job->window] = puzzle;
+    job->fingerprints[index % job->window] = fingerprint;
+
+    /* Flush everything that is now in order */
+    while (job->next_written < job->count &&
+           job->pending[job->next_written % job->window] != NULL) {
+      TilepaintPuzzle **slot = &job->pending[job->next_written % job->window];
+      guint64 *fingerprint_slot =
+          &job->fingerprints[job->next_written % job->window];
+
+      /* The first puzzle in seed order of each kind is the one kept */
+      if (job->index != NULL &&
+          !tilepaint_fingerprint_index_add(job->index, *fingerprint_slot)) {
+        job->n_duplicates++;
+      } else if (job->pack != NULL) {
+        tilepaint_pack_writer_add(job->pack, *slot, (*slot)->difficulty);
+      } else {
+        gchar *line =
+            format_puzzle(*slot, job->seed_start + job->next_written);
+
+        fputs(line, job->output);
+        g_free(line);
+      }
+
+      tilepaint_puzzle_free(*slot);
+      *slot = NULL;
+      job->next_written++;
+    }
+
+    g_cond_broadcast(&job->cond);
+  }
+
+  tilepaint_generator_stats_add(&job->stats, &stats);
+  g_mutex_unlock(&job->lock);
+
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  GOptionContext *context;
+  GError *error = NULL;
+  gint size = 5;
+  gint64 count = 1;
+  gint threads = 0;
+  gint64 seed_start = 1;
+  gchar *output_path = NULL;
+  gboolean write_pack = FALSE;
+  gchar *stats_path = NULL;
+  gchar *difficulty = NULL;
+  gchar *dedup_path = NULL;
+  GenJob job;
+  GThread **workers;
+  gint64 start_time;
+  gdouble elapsed;
+  gint i;
+
+  const GOptionEntry options[] = {
+      {"size", 's', 0, G_OPTION_ARG_INT, &size, "Board size", "N"},
+      {"count", 'n', 0, G_OPTION_ARG_INT64, &count,
+       "Number of puzzles to generate", "N"},
+      {"threads", 't', 0, G_OPTION_ARG_INT, &threads,
+       "Number of worker threads (default: one per core)", "N"},
+      {"seed-start", 0, 0, G_OPTION_ARG_INT64, &seed_start,
+       "Seed of the first puzzle; puzzle i uses seed-start + i", "SEED"},
+      {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path,
+       "File to write to (default: standard output)", "FILE"},
+      {"pack", 0, 0, G_OPTION_ARG_NONE, &write_pack,
+       "Write a binary puzzle pack instead of text; needs --output", NULL},
+      {"stats", 0, 0, G_OPTION_ARG_FILENAME, &stats_path,
+       "Write generation statistics as JSON to FILE", "FILE"},
+      {"difficulty", 'd', 0, G_OPTION_ARG_STRING, &difficulty,
+       "Difficulty to generate: easy, medium, hard or any (default)", "NAME"},
+      {"dedup", 0, 0, G_OPTION_ARG_FILENAME, &dedup_path,
+       "Drop puzzles already in the fingerprint index FILE, and add the rest",
+       "FILE"},
+      {NULL}};
+
+  context = g_option_context_new("- generate Tilepaint puzzles");
+  g_option_context_add_main_entries(context, options, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  if (size < 1 || size > TILEPAINT_PUZZLE_MAX_SIZE) {
+    g_printerr("--size must be between 1 and %d\n", TILEPAINT_PUZZLE_MAX_SIZE);
+    return EXIT_FAILURE;
+  }
+  if (count < 0) {
+    g_printerr("--count must not be negative\n");
+    return EXIT_FAILURE;
+  }
+  if (seed_start < 1 || seed_start + count - 1 > G_MAXUINT) {
+    g_printerr("Seeds must lie between 1 and %u\n", G_MAXUINT);
+    return EXIT_FAILURE;
+  }
+  if (threads <= 0)
+    threads = g_get_num_processors();
+
+  if (difficulty != NULL &&
+      tilepaint_difficulty_from_string(difficulty) ==
+          TILEPAINT_DIFFICULTY_ANY &&
+      g_strcmp0(difficulty, "any") != 0) {
+    g_printerr("--difficulty must be easy, medium, hard or any\n");
+    g_free(difficulty);
+    return EXIT_FAILURE;
+  }
+
+  if (write_pack && (output_path == NULL || g_strcmp0(output_path, "-") == 0)) {
+    g_printerr("--pack needs an --output file\n");
+    return EXIT_FAILURE;
+  }
+
+  job.size = size;
+  job.count = count;
+  job.seed_start = seed_start;
+  job.difficulty = tilepaint_difficulty_from_string(difficulty);
+  g_free(difficulty);
+  job.output = NULL;
+  job.pack = NULL;
+  job.index = NULL;
+  job.n_duplicates = 0;
+
+  if (dedup_path != NULL) {
+    job.index = tilepaint_fingerprint_index_load(dedup_path, &error);
+    if (job.index == NULL) {
+      if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+        g_printerr("Failed to load %s: %s\n", dedup_path, error->message);
+        g_error_free(error);
+        g_free(dedup_path);
+        return EXIT_FAILURE;
+      }
+      g_clear_error(&error);
+      job.index = tilepaint_fingerprint_index_new();
+    }
+  }
+
+  if (write_pack) {
+    job.pack = tilepaint_pack_writer_new();
+  } else if (output_path == NULL || g_strcmp0(output_path, "-") == 0) {
+    job.output = stdout;
+  } else {
+    job.output = fopen(output_path, "w");
+    if (job.output == NULL) {
+      g_printerr("Failed to open %s: %s\n", output_path, g_strerror(errno));
+      g_free(output_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  g_mutex_init(&job.lock);
+  g_cond_init(&job.cond);
+  job.next_index = 0;
+  job.next_written = 0;
+  job.window = threads * REORDER_WINDOW_PER_THREAD;
+  job.pending = g_new0(TilepaintPuzzle *, job.window);
+  job.fingerprints = g_new0(guint64, job.window);
+  memset(&job.stats, 0, sizeof(job.stats));
+
+  start_time = g_get_monotonic_time();
+
+  workers = g_new(GThread *, threads);
+  for (i = 0; i < threads; i++)
+    workers[i] = g_thread_new("tilepaint-gen", gen_thread, &job);
+  for (i = 0; i < threads; i++)
+    g_thread_join(workers[i]);
+  g_free(workers);
+
+  elapsed = (g_get_monotonic_time() - start_time) / (gdouble)G_USEC_PER_SEC;
+  g_printerr("Generated %" G_GINT64_FORMAT " %d×%d puzzles in %.2fs "
+             "(%.1f/s) on %d threads\n",
+             count, size, size, elapsed, elapsed > 0 ? count / elapsed : 0.0,
+             threads);
+
+  g_free(job.pending);
+  g_free(job.fingerprints);
+  g_cond_clear(&job.cond);
+  g_mutex_clear(&job.lock);
+
+  if (job.index != NULL) {
+    gboolean saved;
+
+    g_printerr("Dropped %" G_GUINT64_FORMAT " duplicate puzzles; the index "
+               "now holds %u\n",
+               job.n_duplicates,
+               tilepaint_fingerprint_index_get_size(job.index));
+
+    saved = tilepaint_fingerprint_index_save(job.index, dedup_path, &error);
+    tilepaint_fingerprint_index_free(job.index);
+    if (!saved) {
+      g_printerr("Failed to write %s: %s\n", dedup_path, error->message);
+      g_clear_error(&error);
+    }
+    g_free(dedup_path);
+  }
+
+  if (stats_path != NULL) {
+    gchar *json = tilepaint_generator_stats_to_json(&job.stats, size);
+    gchar *contents = g_strconcat(json, "\n", NULL);
+    gboolean saved = g_file_set_contents(stats_path, contents, -1, &error);
+
+    g_free(json);
+    g_free(contents);
+    if (!saved) {
+      g_printerr("Failed to write %s: %s\n", stats_path, error->message);
+      g_clear_error(&error);
+    }
+    g_free(stats_path);
+  }
+
+  if (job.pack != NULL) {
+    gboolean saved = tilepaint_pack_writer_save(job.pack, output_path, &error);
+
+    tilepaint_pack_writer_free(job.pack);
+    if (!saved) {
+      g_printerr("Failed to write %s: %s\n", output_path, error->message);
+      g_error_free(error);
+      g_free(output_path);
+      return EXIT_FAILURE;
+    }
+  } else if (fflush(job.output) != 0 ||
+             (job.output != stdout && fclose(job.output) != 0)) {
+    g_printerr("Failed to write %s: %s\n",
+               output_path != NULL ? output_path : "output", g_strerror(errno));
+    g_free(output_path);
+    return EXIT_FAILURE;
+  }
+  g_free(output_path);
+
+  return EXIT_SUCCESS;
+}
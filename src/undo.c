@@ -0,0 +1,166 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include "undo.h"
+
+/* The records are kept in a ring buffer, which only ever grows, so that a
+ * move costs no allocation once a game is under way and clearing the history
+ * for a new game is just resetting the counts. With a limit on the number of
+ * records, the oldest move is forgotten to make room for a new one. */
+struct _TilepaintUndoHistory {
+  TilepaintUndoRecord *records;
+  guint capacity;    /* a power of 2, or 0 before the first move */
+  guint max_records; /* 0 for no limit */
+  guint start;       /* index in records of the oldest move */
+  guint length;      /* moves kept, undone ones included */
+  guint position;    /* moves not undone */
+};
+
+/* Records allocated for the first move */
+#define UNDO_MIN_CAPACITY 256
+
+#define undo_record(history, i)                                                \
+  (&(history)->records[((history)->start + (i)) & ((history)->capacity - 1)])
+
+/* Doubles the ring buffer, straightening it out so that it starts at 0 */
+static void undo_history_grow(TilepaintUndoHistory *history) {
+  guint capacity = MAX(history->capacity * 2, UNDO_MIN_CAPACITY);
+  TilepaintUndoRecord *records = g_new(TilepaintUndoRecord, capacity);
+  guint head = history->capacity - history->start;
+
+  if (history->length > 0) {
+    if (head >= history->length) {
+      memcpy(records, &history->records[history->start],
+             history->length * sizeof(*records));
+    } else {
+      memcpy(records, &history->records[history->start],
+             head * sizeof(*records));
+      memcpy(&records[head], history->records,
+             (history->length - head) * sizeof(*records));
+    }
+  }
+
+  g_free(history->records);
+  history->records = records;
+  history->capacity = capacity;
+  history->start = 0;
+}
+
+/* max_records is the most moves kept, or 0 for no limit */
+TilepaintUndoHistory *tilepaint_undo_history_new(guint max_records) {
+  TilepaintUndoHistory *history = g_new0(TilepaintUndoHistory, 1);
+
+  history->max_records = max_records;
+
+  return history;
+}
+
+void tilepaint_undo_history_free(TilepaintUndoHistory *history) {
+  if (history == NULL)
+    return;
+
+  g_free(history->records);
+  g_free(history);
+}
+
+/* Forgets every move, keeping the memory for the next game */
+void tilepaint_undo_history_clear(TilepaintUndoHistory *history) {
+  g_return_if_fail(history != NULL);
+
+  history->start = 0;
+  history->length = 0;
+  history->position = 0;
+}
+
+/* Records a move, forgetting any undone ones. A joined move is undone and
+ * redone along with the move before it. */
+void tilepaint_undo_history_push(TilepaintUndoHistory *history, guint8 type,
+                                 guint8 x, guint8 y, gboolean joined) {
+  TilepaintUndoRecord *record;
+
+  g_return_if_fail(history != NULL);
+
+  history->length = history->position;
+
+  if (history->max_records != 0 && history->length == history->max_records) {
+    history->start = (history->start + 1) & (history->capacity - 1);
+    history->length--;
+  } else if (history->length == history->capacity) {
+    undo_history_grow(history);
+  }
+
+  record = undo_record(history, history->length);
+  record->type = type;
+  record->x = x;
+  record->y = y;
+  record->joined = joined;
+
+  history->length++;
+  history->position = history->length;
+}
+
+gboolean tilepaint_undo_history_can_undo(const TilepaintUndoHistory *history) {
+  g_return_val_if_fail(history != NULL, FALSE);
+
+  return history->position > 0;
+}
+
+gboolean tilepaint_undo_history_can_redo(const TilepaintUndoHistory *history) {
+  g_return_val_if_fail(history != NULL, FALSE);
+
+  return history->position < history->length;
+}
+
+/* Whether the next move to redo is joined to the one before it, and so must be
+ * redone too to finish the step */
+gboolean
+tilepaint_undo_history_redo_is_joined(const TilepaintUndoHistory *history) {
+  g_return_val_if_fail(history != NULL, FALSE);
+
+  return history->position < history->length &&
+         undo_record(history, history->position)->joined;
+}
+
+/* Steps back over the last move not undone, and returns it for the caller to
+ * reverse, or returns NULL if there isn't one. The record is only valid until
+ * the next move is pushed. */
+const TilepaintUndoRecord *
+tilepaint_undo_history_undo(TilepaintUndoHistory *history) {
+  g_return_val_if_fail(history != NULL, NULL);
+
+  if (history->position == 0)
+    return NULL;
+
+  return undo_record(history, --history->position);
+}
+
+/* Steps forward over the first undone move, and returns it for the caller to
+ * make again, or returns NULL if there isn't one */
+const TilepaintUndoRecord *
+tilepaint_undo_history_redo(TilepaintUndoHistory *history) {
+  g_return_val_if_fail(history != NULL, NULL);
+
+  if (history->position == history->length)
+    return NULL;
+
+  return undo_record(history, history->position++);
+}
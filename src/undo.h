@@ -0,0 +1,59 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/*
+ * Tilepaint
+ * Copyright (C) Thiago Fernandes 2026 <thiago@example.com>
+ *
+ * Tilepaint is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Tilepaint is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Tilepaint.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TILEPAINT_UNDO_H
+#define TILEPAINT_UNDO_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* One move, as undone and redone, packed into 4 bytes. What type means is up
+ * to the caller. A joined move is part of the same step as the one before it,
+ * as each cell of a drag is, so that the step is undone and redone as a
+ * whole. */
+typedef struct {
+  guint8 type;
+  guint8 x;
+  guint8 y;
+  guint8 joined;
+} TilepaintUndoRecord;
+
+G_STATIC_ASSERT(sizeof(TilepaintUndoRecord) == 4);
+
+/* The moves of a game, oldest first, with those undone kept for redoing */
+typedef struct _TilepaintUndoHistory TilepaintUndoHistory;
+
+TilepaintUndoHistory *tilepaint_undo_history_new(guint max_records);
+void tilepaint_undo_history_free(TilepaintUndoHistory *history);
+void tilepaint_undo_history_clear(TilepaintUndoHistory *history);
+void tilepaint_undo_history_push(TilepaintUndoHistory *history, guint8 type,
+                                 guint8 x, guint8 y, gboolean joined);
+gboolean tilepaint_undo_history_can_undo(const TilepaintUndoHistory *history);
+gboolean tilepaint_undo_history_can_redo(const TilepaintUndoHistory *history);
+gboolean
+tilepaint_undo_history_redo_is_joined(const TilepaintUndoHistory *history);
+const TilepaintUndoRecord *
+tilepaint_undo_history_undo(TilepaintUndoHistory *history);
+const TilepaintUndoRecord *
+tilepaint_undo_history_redo(TilepaintUndoHistory *history);
+
+G_END_DECLS
+
+#endif /* TILEPAINT_UNDO_H */
@@ -0,0 +1,190 @@
+/* bench-generator.c — times board generation and uniqueness checks.
+ *
+ * Links the production generator.c and solver.c. For every size from
+ * BENCH_MIN_SIZE to TILEPAINT_PUZZLE_MAX_SIZE it generates boards from the
+ * fixed seeds 1..N on one thread, then counts the solutions of each finished
+ * board again on its own. Per size it reports boards/sec, p50/p99 generation
+ * latency, attempts per board, and solver nodes/sec, and with --output writes
+ * the same as JSON.
+ *
+ * Runs under `meson test --benchmark` (or `ninja benchmark`). To compare a run
+ * with an earlier one, copy its JSON to tests/bench-baseline.json and run
+ * `ninja bench-compare` after the next benchmark run.
+ */
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/generator.h"
+#include "../src/solver.h"
+
+#define BENCH_MIN_SIZE 3
+
+typedef struct {
+  guint size;
+  guint boards;
+  gdouble boards_per_sec;
+  gdouble p50_ms;
+  gdouble p99_ms;
+  gdouble attempts_per_board;
+  gdouble nodes_per_sec;     /* while generating */
+  gdouble solve_p50_us;      /* counting a finished board's solutions */
+  gdouble solve_p99_us;
+  gdouble solve_nodes_per_sec;
+} BenchResult;
+
+static gint compare_doubles(gconstpointer a, gconstpointer b) {
+  gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+
+  return (x > y) - (x < y);
+}
+
+/* The q-th quantile of n sorted values, by the nearest-rank method */
+static gdouble quantile(const gdouble *sorted, guint n, gdouble q) {
+  guint rank = (guint)(q * n + 0.999999);
+
+  return sorted[CLAMP(rank, 1, n) - 1];
+}
+
+static void bench_size(guint size, guint n_boards, BenchResult *result) {
+  TilepaintGeneratorStats stats = {0};
+  TilepaintSolverStats solve_stats = {0};
+  gdouble *latencies = g_new(gdouble, n_boards);
+  gdouble *solve_times = g_new(gdouble, n_boards);
+  gdouble total = 0, solve_total = 0;
+  guint i;
+
+  for (i = 0; i < n_boards; i++) {
+    TilepaintGeneratorOptions options = {i + 1, 1, &stats};
+    TilepaintPuzzle *puzzle;
+    gint64 start = g_get_monotonic_time();
+
+    puzzle = tilepaint_puzzle_generate(size, &options, NULL);
+    latencies[i] = (g_get_monotonic_time() - start) / 1000.0;
+    total += latencies[i];
+
+    start = g_get_monotonic_time();
+    if (tilepaint_solver_count(puzzle, TILEPAINT_SOLVER_PROPAGATE, G_MAXUINT,
+                               NULL, NULL, &solve_stats) != 1)
+      g_error("Seed %u gave a %u×%u board without a unique solution", i + 1,
+              size, size);
+    solve_times[i] = (gdouble)(g_get_monotonic_time() - start);
+    solve_total += solve_times[i];
+
+    tilepaint_puzzle_free(puzzle);
+  }
+
+  qsort(latencies, n_boards, sizeof(gdouble), compare_doubles);
+  qsort(solve_times, n_boards, sizeof(gdouble), compare_doubles);
+
+  result->size = size;
+  result->boards = n_boards;
+  result->boards_per_sec = total > 0 ? n_boards / (total / 1000.0) : 0;
+  result->p50_ms = quantile(latencies, n_boards, 0.50);
+  result->p99_ms = quantile(latencies, n_boards, 0.99);
+  result->attempts_per_board = (gdouble)stats.attempts / n_boards;
+  result->nodes_per_sec =
+      stats.unique_time > 0
+          ? stats.solver.nodes / (stats.unique_time / (gdouble)G_USEC_PER_SEC)
+          : 0;
+  result->solve_p50_us = quantile(solve_times, n_boards, 0.50);
+  result->solve_p99_us = quantile(solve_times, n_boards, 0.99);
+  result->solve_nodes_per_sec =
+      solve_total > 0
+          ? solve_stats.nodes / (solve_total / (gdouble)G_USEC_PER_SEC)
+          : 0;
+
+  g_free(latencies);
+  g_free(solve_times);
+}
+
+static gchar *results_to_json(const BenchResult *results, guint n_results) {
+  GString *json = g_string_new("{\n  \"sizes\": [\n");
+
+  for (guint i = 0; i < n_results; i++) {
+    const BenchResult *r = &results[i];
+
+    g_string_append_printf(
+        json,
+        "    {\"size\": %u, \"boards\": %u, \"boards_per_sec\": %.1f, "
+        "\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"attempts_per_board\": %.2f, "
+        "\"nodes_per_sec\": %.0f, \"solve_p50_us\": %.1f, "
+        "\"solve_p99_us\": %.1f, \"solve_nodes_per_sec\": %.0f}%s\n",
+        r->size, r->boards, r->boards_per_sec, r->p50_ms, r->p99_ms,
+        r->attempts_per_board, r->nodes_per_sec, r->solve_p50_us,
+        r->solve_p99_us, r->solve_nodes_per_sec,
+        i + 1 < n_results ? "," : "");
+  }
+
+  g_string_append(json, "  ]\n}\n");
+
+  return g_string_free(json, FALSE);
+}
+
+int main(int argc, char *argv[]) {
+  GOptionContext *context;
+  GError *error = NULL;
+  gint n_boards = 100;
+  gint max_size = TILEPAINT_PUZZLE_MAX_SIZE;
+  gchar *output_path = NULL;
+  BenchResult *results;
+  guint n_results = 0;
+  gchar *json;
+
+  const GOptionEntry options[] = {
+      {"boards", 'n', 0, G_OPTION_ARG_INT, &n_boards,
+       "Boards per size, from seeds 1..N", "N"},
+      {"max-size", 0, 0, G_OPTION_ARG_INT, &max_size,
+       "Largest board size to run", "N"},
+      {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_path,
+       "File to write the results to as JSON", "FILE"},
+      {NULL}};
+
+  context = g_option_context_new("- benchmark board generation");
+  g_option_context_add_main_entries(context, options, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  if (n_boards < 1 || max_size < BENCH_MIN_SIZE ||
+      max_size > TILEPAINT_PUZZLE_MAX_SIZE) {
+    g_printerr("--boards must be positive and --max-size between %d and %d\n",
+               BENCH_MIN_SIZE, TILEPAINT_PUZZLE_MAX_SIZE);
+    return EXIT_FAILURE;
+  }
+
+  results = g_new(BenchResult, max_size - BENCH_MIN_SIZE + 1);
+
+  printf("%5s %10s %9s %9s %9s %12s %10s %10s\n", "size", "boards/s",
+         "p50 ms", "p99 ms", "attempts", "nodes/s", "solve p50", "solve p99");
+
+  for (gint size = BENCH_MIN_SIZE; size <= max_size; size++) {
+    BenchResult *r = &results[n_results++];
+
+    bench_size(size, n_boards, r);
+    printf("%5u %10.1f %9.3f %9.3f %9.2f %12.0f %8.1fus %8.1fus\n", r->size,
+           r->boards_per_sec, r->p50_ms, r->p99_ms, r->attempts_per_board,
+           r->nodes_per_sec, r->solve_p50_us, r->solve_p99_us);
+    fflush(stdout);
+  }
+
+  json = results_to_json(results, n_results);
+  if (output_path != NULL &&
+      !g_file_set_contents(output_path, json, -1, &error)) {
+    g_printerr("Failed to write %s: %s\n", output_path, error->message);
+    g_error_free(error);
+    g_free(json);
+    g_free(results);
+    g_free(output_path);
+    return EXIT_FAILURE;
+  }
+
+  g_free(json);
+  g_free(results);
+  g_free(output_path);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,290 @@
+/* fuzz-solver.c — cross-checks every solver engine against brute force.
+ *
+ * Links the production generator.c and solver.c. Each input is turned into a
+ * small board: tiles grown by joining cells to a neighbour, and clues either
+ * counted from a random painting of the tiles or made up outright, so that
+ * boards with no, one and many solutions all come up. Every engine, run in
+ * one go and a node at a time, must give the same count, capped at 2, as
+ * trying every painting of the tiles, and the witness search must find a
+ * second solution exactly when there is one.
+ *
+ * Built as a seeded loop, which `meson test` runs, it also reports the
+ * throughput of each engine, so that a slowdown shows up next to any wrong
+ * answer. Configured with -Dlibfuzzer=true, it is also built with clang's
+ * libFuzzer as fuzz-solver-libfuzzer.
+ */
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/generator.h"
+#include "../src/solver.h"
+
+/* Brute force tries 2^tiles paintings, so boards are kept small */
+#define FUZZ_MAX_SIZE 6
+#define FUZZ_MAX_TILES 16
+
+/* Bytes the seeded loop feeds each board; more than a board can use */
+#define FUZZ_INPUT_SIZE 128
+
+typedef struct {
+  const guint8 *data;
+  gsize size;
+  gsize pos;
+} FuzzInput;
+
+typedef struct {
+  const gchar *name;
+  guint64 boards;
+  guint64 nodes;
+  gint64 time; /* microseconds */
+} EngineThroughput;
+
+static const TilepaintSolverEngine engines[] = {
+    TILEPAINT_SOLVER_SEARCH,
+    TILEPAINT_SOLVER_PROPAGATE,
+    TILEPAINT_SOLVER_MEET_IN_MIDDLE,
+};
+
+/* The engines, then brute force */
+static EngineThroughput throughput[] = {
+    {"search"}, {"propagate"}, {"meet-in-middle"}, {"brute force"}};
+
+/* Seed of the board being checked by the seeded loop, or -1 */
+static gint64 fuzz_seed = -1;
+
+/* Reads the next byte, or 0 once the input runs out */
+static guint8 fuzz_byte(FuzzInput *input) {
+  return input->pos < input->size ? input->data[input->pos++] : 0;
+}
+
+static TilepaintPuzzle *fuzz_puzzle(FuzzInput *input) {
+  guint size = 1 + fuzz_byte(input) % FUZZ_MAX_SIZE;
+  guint max_tiles = 1 + fuzz_byte(input) % FUZZ_MAX_TILES;
+  gboolean made_up_clues = fuzz_byte(input) & 1;
+  TilepaintPuzzle *puzzle = tilepaint_puzzle_new(size);
+  guchar colours[FUZZ_MAX_TILES];
+  guint x, y;
+
+  /* Each cell starts a tile or joins the one to its left or above, so every
+   * tile is connected. Starting tiles more often than not gives many small
+   * ones, which is what makes a second solution likely. */
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      guint i = x * size + y;
+      guint8 choice = fuzz_byte(input);
+
+      if ((x == 0 && y == 0) ||
+          (choice % 4 != 0 && puzzle->num_tiles < max_tiles)) {
+        puzzle->tile_ids[i] = puzzle->num_tiles++;
+      } else if (x == 0 || (y > 0 && (choice & 4))) {
+        puzzle->tile_ids[i] = puzzle->tile_ids[i - 1];
+      } else {
+        puzzle->tile_ids[i] = puzzle->tile_ids[i - size];
+      }
+    }
+  }
+
+  for (guint tile = 0; tile < puzzle->num_tiles; tile++)
+    colours[tile] = fuzz_byte(input) & 1;
+
+  for (x = 0; x < size; x++) {
+    for (y = 0; y < size; y++) {
+      guint i = x * size + y;
+
+      puzzle->solution[i] = colours[puzzle->tile_ids[i]];
+      puzzle->row_clues[y] += puzzle->solution[i];
+      puzzle->col_clues[x] += puzzle->solution[i];
+    }
+  }
+
+  /* Made-up clues mostly have no solution; puzzle->solution is then left
+   * as it is, but isn't one */
+  if (made_up_clues) {
+    for (x = 0; x < size; x++) {
+      puzzle->row_clues[x] = fuzz_byte(input) % (size + 1);
+      puzzle->col_clues[x] = fuzz_byte(input) % (size + 1);
+    }
+  }
+
+  return puzzle;
+}
+
+static gboolean is_solution(const TilepaintPuzzle *puzzle,
+                            const guchar *painting) {
+  guint size = puzzle->size;
+
+  for (guint a = 0; a < size; a++) {
+    guint row = 0, col = 0;
+
+    for (guint b = 0; b < size; b++) {
+      row += painting[b * size + a] != 0;
+      col += painting[a * size + b] != 0;
+    }
+
+    if (row != puzzle->row_clues[a] || col != puzzle->col_clues[a])
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Counts solutions by trying every painting of the tiles, stopping at 2 */
+static guint brute_force_count(const TilepaintPuzzle *puzzle) {
+  guint n_cells = puzzle->size * puzzle->size;
+  guchar painting[FUZZ_MAX_SIZE * FUZZ_MAX_SIZE];
+  guint n_solutions = 0;
+
+  for (guint32 tiles = 0; tiles < 1u << puzzle->num_tiles; tiles++) {
+    for (guint i = 0; i < n_cells; i++)
+      painting[i] = (tiles >> puzzle->tile_ids[i]) & 1;
+
+    if (is_solution(puzzle, painting) && ++n_solutions == 2)
+      break;
+  }
+
+  return n_solutions;
+}
+
+static void print_puzzle(const TilepaintPuzzle *puzzle) {
+  guint size = puzzle->size;
+
+  if (fuzz_seed >= 0)
+    fprintf(stderr, "Board with seed %" G_GINT64_FORMAT ":\n", fuzz_seed);
+
+  for (guint y = 0; y < size; y++) {
+    for (guint x = 0; x < size; x++)
+      fprintf(stderr, "%3u", puzzle->tile_ids[x * size + y]);
+    fprintf(stderr, "  | %u\n", puzzle->row_clues[y]);
+  }
+  for (guint x = 0; x < size; x++)
+    fprintf(stderr, "%3u", puzzle->col_clues[x]);
+  fprintf(stderr, "\n");
+}
+
+static void check_count(const TilepaintPuzzle *puzzle, const gchar *what,
+                        guint count, guint expected) {
+  if (count != expected) {
+    print_puzzle(puzzle);
+    g_error("%s counted %u solutions, but there are %u", what, count,
+            expected);
+  }
+}
+
+static void fuzz_one(const guint8 *data, gsize size) {
+  FuzzInput input = {data, size, 0};
+  TilepaintPuzzle *puzzle = fuzz_puzzle(&input);
+  guchar witness[FUZZ_MAX_SIZE * FUZZ_MAX_SIZE];
+  gint64 start = g_get_monotonic_time();
+  guint expected, n_solutions;
+  gboolean found;
+
+  expected = brute_force_count(puzzle);
+  throughput[G_N_ELEMENTS(engines)].time += g_get_monotonic_time() - start;
+  throughput[G_N_ELEMENTS(engines)].boards++;
+
+  for (guint i = 0; i < G_N_ELEMENTS(engines); i++) {
+    TilepaintSolverStats stats = {0};
+    guint count;
+
+    start = g_get_monotonic_time();
+    count = tilepaint_solver_count(puzzle, engines[i], G_MAXUINT, NULL, NULL,
+                                   &stats);
+    throughput[i].time += g_get_monotonic_time() - start;
+    throughput[i].boards++;
+    throughput[i].nodes += stats.nodes;
+
+    check_count(puzzle, throughput[i].name, count, expected);
+
+    if (engines[i] != TILEPAINT_SOLVER_MEET_IN_MIDDLE) {
+      TilepaintSolver *solver = tilepaint_solver_new(puzzle, engines[i],
+                                                     G_MAXUINT);
+
+      while (!tilepaint_solver_step(solver, 1))
+        ;
+      check_count(puzzle, "Stepping", tilepaint_solver_get_n_solutions(solver),
+                  expected);
+      tilepaint_solver_free(solver);
+    }
+  }
+
+  /* The witness search needs puzzle->solution to be a solution */
+  if (expected > 0 && is_solution(puzzle, puzzle->solution)) {
+    found = tilepaint_solver_find_witness(puzzle, G_MAXUINT, NULL, NULL, NULL,
+                                          witness, &n_solutions);
+    check_count(puzzle, "The witness search", n_solutions, expected);
+
+    if (found != (expected == 2) ||
+        (found && (!is_solution(puzzle, witness) ||
+                   memcmp(witness, puzzle->solution,
+                          puzzle->size * puzzle->size) == 0))) {
+      print_puzzle(puzzle);
+      g_error("The witness search %s a second solution wrongly",
+              found ? "found" : "missed");
+    }
+  }
+
+  tilepaint_puzzle_free(puzzle);
+}
+
+#ifdef TILEPAINT_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const guint8 *data, gsize size);
+
+int LLVMFuzzerTestOneInput(const guint8 *data, gsize size) {
+  fuzz_one(data, size);
+  return 0;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+  GOptionContext *context;
+  GError *error = NULL;
+  gint iterations = 20000;
+  gint seed = 1;
+  guint8 data[FUZZ_INPUT_SIZE];
+
+  const GOptionEntry options[] = {
+      {"iterations", 'n', 0, G_OPTION_ARG_INT, &iterations,
+       "Number of boards to check", "N"},
+      {"seed", 's', 0, G_OPTION_ARG_INT, &seed,
+       "Seed of the first board; board i uses seed + i", "SEED"},
+      {NULL}};
+
+  context = g_option_context_new("- cross-check the solver engines");
+  g_option_context_add_main_entries(context, options, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return EXIT_FAILURE;
+  }
+  g_option_context_free(context);
+
+  for (gint i = 0; i < iterations; i++) {
+    GRand *rng = g_rand_new_with_seed(seed + i);
+
+    for (guint j = 0; j < FUZZ_INPUT_SIZE; j++)
+      data[j] = g_rand_int_range(rng, 0, 256);
+    g_rand_free(rng);
+
+    fuzz_seed = seed + i;
+    fuzz_one(data, sizeof(data));
+  }
+
+  printf("%-16s %10s %12s %14s\n", "engine", "boards", "boards/s",
+         "nodes/s");
+  for (guint i = 0; i < G_N_ELEMENTS(throughput); i++) {
+    const EngineThroughput *t = &throughput[i];
+    gdouble seconds = t->time / (gdouble)G_USEC_PER_SEC;
+
+    printf("%-16s %10" G_GUINT64_FORMAT " %12.0f %14.0f\n", t->name, t->boards,
+           seconds > 0 ? t->boards / seconds : 0,
+           seconds > 0 ? t->nodes / seconds : 0);
+  }
+
+  return EXIT_SUCCESS;
+}
+
+#endif
@@ -98,12 +98,14 @@ static void test_feedback_enabled_colors(void) {
 
 static void test_board_integration(void) {
   TilepaintApplication app = {0};
+  guchar row_clues[10] = {0};
+  guchar col_clues[10] = {0};
   app.theme = &theme_dark_test;
   app.board_size = 5;
-  TilepaintCell *rows5[10];
-  TilepaintCell data5[10][10] = {0};
-  for (int x = 0; x < 5; x++) rows5[x] = data5[x];
-  app.board = rows5;
+  app.row_clues = row_clues;
+  app.col_clues = col_clues;
+  TilepaintCell data5[5][5] = {0};
+  app.board = &data5[0][0];
   app.col_clues[0] = 2;
   app.row_clues[0] = 2;
   data5[0][0].status = CELL_PAINTED;
@@ -124,10 +126,8 @@ static void test_board_integration(void) {
   g_assert_true(rgba_equal(c, app.theme->error_text));
 
   app.board_size = 10;
-  TilepaintCell *rows10[10];
   TilepaintCell data10[10][10] = {0};
-  for (int x = 0; x < 10; x++) rows10[x] = data10[x];
-  app.board = rows10;
+  app.board = &data10[0][0];
   app.col_clues[5] = 5;
   app.row_clues[5] = 10;
   for (int x = 0; x < 5; x++) data10[x][5].status = CELL_PAINTED;
@@ -0,0 +1,267 @@
+/* test-pack.c — round-trips generated puzzles through a puzzle pack.
+ *
+ * Links the production generator.c and pack.c: every puzzle read back from
+ * the pack must match the one written, tile ids included, and a damaged
+ * record must be reported rather than decoded. Fingerprints must be the same
+ * for a board turned, mirrored or with its tiles numbered otherwise and tell
+ * other boards apart, and must come back from a saved fingerprint index.
+ */
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include "../src/generator.h"
+#include "../src/pack.h"
+
+#define PUZZLES_PER_SIZE 4
+
+/* Larger boards take too long to generate for a unit test */
+#define TEST_MAX_SIZE 10
+
+static void assert_puzzles_equal(const TilepaintPuzzle *a,
+                                 const TilepaintPuzzle *b) {
+  g_assert_cmpuint(a->size, ==, b->size);
+  g_assert_cmpuint(a->num_tiles, ==, b->num_tiles);
+  g_assert_cmpmem(a->tile_ids, a->size * a->size * sizeof(*a->tile_ids),
+                  b->tile_ids, b->size * b->size * sizeof(*b->tile_ids));
+  g_assert_cmpmem(a->solution, a->size * a->size, b->solution,
+                  b->size * b->size);
+  g_assert_cmpmem(a->row_clues, a->size, b->row_clues, b->size);
+  g_assert_cmpmem(a->col_clues, a->size, b->col_clues, b->size);
+}
+
+static TilepaintPuzzle *generate(guint size, guint seed) {
+  TilepaintGeneratorOptions options = {seed, 1};
+
+  return tilepaint_puzzle_generate(size, &options, NULL);
+}
+
+static gchar *write_pack(guint min_size, guint max_size) {
+  TilepaintPackWriter *writer = tilepaint_pack_writer_new();
+  GError *error = NULL;
+  gchar *filename;
+  gint fd;
+
+  fd = g_file_open_tmp("test-pack-XXXXXX", &filename, &error);
+  g_assert_no_error(error);
+  g_close(fd, NULL);
+
+  /* Add sizes in descending order; the writer must sort its index */
+  for (guint size = max_size; size >= min_size; size--) {
+    for (guint i = 0; i < PUZZLES_PER_SIZE; i++) {
+      TilepaintPuzzle *puzzle = generate(size, size * 100 + i + 1);
+
+      tilepaint_pack_writer_add(writer, puzzle, i % 2);
+      tilepaint_puzzle_free(puzzle);
+    }
+  }
+
+  g_assert_true(tilepaint_pack_writer_save(writer, filename, &error));
+  g_assert_no_error(error);
+  tilepaint_pack_writer_free(writer);
+
+  return filename;
+}
+
+static void test_round_trip(void) {
+  gchar *filename = write_pack(1, TEST_MAX_SIZE);
+  GError *error = NULL;
+  TilepaintPack *pack = tilepaint_pack_open(filename, &error);
+
+  g_assert_no_error(error);
+  g_assert_nonnull(pack);
+
+  for (guint size = 1; size <= TEST_MAX_SIZE; size++) {
+    g_assert_cmpuint(
+        tilepaint_pack_get_n_puzzles(pack, size, TILEPAINT_PACK_ANY_DIFFICULTY),
+        ==, PUZZLES_PER_SIZE);
+    g_assert_cmpuint(tilepaint_pack_get_n_puzzles(pack, size, 1), ==,
+                     PUZZLES_PER_SIZE / 2);
+
+    /* Difficulty 1 holds the odd-numbered puzzles */
+    for (guint i = 0; i < PUZZLES_PER_SIZE / 2; i++) {
+      TilepaintPuzzle *expected = generate(size, size * 100 + 2 * i + 2);
+      TilepaintPuzzle *actual =
+          tilepaint_pack_get_puzzle(pack, size, 1, i, &error);
+
+      g_assert_no_error(error);
+      assert_puzzles_equal(expected, actual);
+      tilepaint_puzzle_free(expected);
+      tilepaint_puzzle_free(actual);
+    }
+  }
+
+  g_assert_cmpuint(tilepaint_pack_get_n_puzzles(pack, 0, 0), ==, 0);
+  g_assert_cmpuint(tilepaint_pack_get_n_puzzles(pack, TEST_MAX_SIZE + 1,
+                                                TILEPAINT_PACK_ANY_DIFFICULTY),
+                   ==, 0);
+
+  tilepaint_pack_free(pack);
+  g_unlink(filename);
+  g_free(filename);
+}
+
+static void test_corrupt_record(void) {
+  gchar *filename = write_pack(5, 5);
+  GError *error = NULL;
+  TilepaintPack *pack;
+  TilepaintPuzzle *puzzle;
+  gchar *contents;
+  gsize length;
+
+  /* Flip a bit in the last record's clues */
+  g_assert_true(g_file_get_contents(filename, &contents, &length, &error));
+  contents[length - 1] ^= 1;
+  g_assert_true(g_file_set_contents(filename, contents, length, &error));
+  g_free(contents);
+
+  pack = tilepaint_pack_open(filename, &error);
+  g_assert_no_error(error);
+
+  puzzle = tilepaint_pack_get_puzzle(pack, 5, 1, PUZZLES_PER_SIZE / 2 - 1,
+                                     &error);
+  g_assert_null(puzzle);
+  g_assert_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_CORRUPT);
+  g_clear_error(&error);
+
+  tilepaint_pack_free(pack);
+  g_unlink(filename);
+  g_free(filename);
+}
+
+static void test_not_a_pack(void) {
+  GError *error = NULL;
+  gchar *filename;
+  gint fd;
+
+  fd = g_file_open_tmp("test-pack-XXXXXX", &filename, &error);
+  g_assert_no_error(error);
+  g_close(fd, NULL);
+  g_assert_true(g_file_set_contents(filename, "TPPX", -1, &error));
+
+  g_assert_null(tilepaint_pack_open(filename, &error));
+  g_assert_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_INVALID);
+  g_clear_error(&error);
+
+  g_unlink(filename);
+  g_free(filename);
+}
+
+static gboolean puzzles_equal(const TilepaintPuzzle *a,
+                              const TilepaintPuzzle *b) {
+  guint n_cells = a->size * a->size;
+
+  return a->size == b->size && a->num_tiles == b->num_tiles &&
+         memcmp(a->tile_ids, b->tile_ids, n_cells * sizeof(*a->tile_ids)) ==
+             0 &&
+         memcmp(a->solution, b->solution, n_cells) == 0 &&
+         memcmp(a->row_clues, b->row_clues, a->size) == 0 &&
+         memcmp(a->col_clues, b->col_clues, a->size) == 0;
+}
+
+/* Boards with the same fingerprint must be the same up to turning and
+ * mirroring, and how their tiles are numbered */
+static void test_fingerprint(void) {
+  enum { N_BOARDS = 200, SIZE = 6 };
+  TilepaintPuzzle *puzzles[N_BOARDS];
+  guint64 fingerprints[N_BOARDS];
+
+  for (guint size = 1; size <= TEST_MAX_SIZE; size++) {
+    TilepaintPuzzle *puzzle = generate(size, size);
+    guint64 fingerprint = tilepaint_puzzle_fingerprint(puzzle);
+
+    g_assert_cmpuint(fingerprint, !=, 0);
+    for (guint transform = 0; transform < 8; transform++) {
+      TilepaintPuzzle *copy = tilepaint_puzzle_transform(puzzle, transform);
+
+      g_assert_cmpuint(tilepaint_puzzle_fingerprint(copy), ==, fingerprint);
+      tilepaint_puzzle_free(copy);
+    }
+
+    /* The same board with its tiles numbered backwards */
+    for (guint i = 0; i < size * size; i++)
+      puzzle->tile_ids[i] = puzzle->num_tiles - 1 - puzzle->tile_ids[i];
+    g_assert_cmpuint(tilepaint_puzzle_fingerprint(puzzle), ==, fingerprint);
+
+    tilepaint_puzzle_free(puzzle);
+  }
+
+  for (guint i = 0; i < N_BOARDS; i++) {
+    puzzles[i] = generate(SIZE, i + 1);
+    fingerprints[i] = tilepaint_puzzle_fingerprint(puzzles[i]);
+  }
+
+  for (guint i = 0; i < N_BOARDS; i++) {
+    for (guint j = i + 1; j < N_BOARDS; j++) {
+      gboolean equivalent = FALSE;
+
+      for (guint transform = 0; transform < 8 && !equivalent; transform++) {
+        TilepaintPuzzle *copy =
+            tilepaint_puzzle_transform(puzzles[i], transform);
+
+        equivalent = puzzles_equal(copy, puzzles[j]);
+        tilepaint_puzzle_free(copy);
+      }
+
+      g_assert_cmpint(fingerprints[i] == fingerprints[j], ==, equivalent);
+    }
+  }
+
+  for (guint i = 0; i < N_BOARDS; i++)
+    tilepaint_puzzle_free(puzzles[i]);
+}
+
+static void test_fingerprint_index(void) {
+  enum { N_FINGERPRINTS = 5000 };
+  TilepaintFingerprintIndex *index = tilepaint_fingerprint_index_new();
+  GRand *rng = g_rand_new_with_seed(1);
+  guint64 *fingerprints = g_new(guint64, N_FINGERPRINTS);
+  GError *error = NULL;
+  gchar *filename;
+  gint fd;
+
+  /* Enough to grow the table several times over */
+  for (guint i = 0; i < N_FINGERPRINTS; i++) {
+    fingerprints[i] = (guint64)g_rand_int(rng) << 32 | g_rand_int(rng) | 1;
+    g_assert_false(
+        tilepaint_fingerprint_index_contains(index, fingerprints[i]));
+    g_assert_true(tilepaint_fingerprint_index_add(index, fingerprints[i]));
+    g_assert_false(tilepaint_fingerprint_index_add(index, fingerprints[i]));
+  }
+
+  fd = g_file_open_tmp("test-pack-XXXXXX", &filename, &error);
+  g_assert_no_error(error);
+  g_close(fd, NULL);
+  g_assert_true(tilepaint_fingerprint_index_save(index, filename, &error));
+  g_assert_no_error(error);
+  tilepaint_fingerprint_index_free(index);
+
+  index = tilepaint_fingerprint_index_load(filename, &error);
+  g_assert_no_error(error);
+  g_assert_cmpuint(tilepaint_fingerprint_index_get_size(index), ==,
+                   N_FINGERPRINTS);
+  for (guint i = 0; i < N_FINGERPRINTS; i++)
+    g_assert_true(tilepaint_fingerprint_index_contains(index, fingerprints[i]));
+  g_assert_false(tilepaint_fingerprint_index_contains(index, 2));
+  tilepaint_fingerprint_index_free(index);
+
+  /* A pack is not an index */
+  g_assert_true(g_file_set_contents(filename, "TPPK", -1, &error));
+  g_assert_null(tilepaint_fingerprint_index_load(filename, &error));
+  g_assert_error(error, TILEPAINT_PACK_ERROR, TILEPAINT_PACK_ERROR_INVALID);
+  g_clear_error(&error);
+
+  g_unlink(filename);
+  g_free(filename);
+  g_free(fingerprints);
+  g_rand_free(rng);
+}
+
+int main(int argc, char *argv[]) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/pack/round_trip", test_round_trip);
+  g_test_add_func("/pack/corrupt_record", test_corrupt_record);
+  g_test_add_func("/pack/not_a_pack", test_not_a_pack);
+  g_test_add_func("/pack/fingerprint", test_fingerprint);
+  g_test_add_func("/pack/fingerprint_index", test_fingerprint_index);
+  return g_test_run();
+}
@@ -0,0 +1,471 @@
+/* test-solver.c — checks the solver engines against boards with known
+ * solution counts.
+ *
+ * Links the production generator.c and solver.c. Every engine must agree on
+ * every board, and generated boards must be unique by all of them. Searches
+ * and generation run a node at a time must end exactly where running them in
+ * one go does.
+ */
+#include <glib.h>
+#include <string.h>
+#include "../src/generator.h"
+#include "../src/solver.h"
+
+static const TilepaintSolverEngine engines[] = {
+    TILEPAINT_SOLVER_SEARCH,
+    TILEPAINT_SOLVER_PROPAGATE,
+    TILEPAINT_SOLVER_MEET_IN_MIDDLE,
+};
+
+/* Builds a board from row-major tile ids and its clues */
+static TilepaintPuzzle *make_puzzle(guint size, const guint16 *tiles,
+                                    const guchar *row_clues,
+                                    const guchar *col_clues) {
+  TilepaintPuzzle *puzzle = tilepaint_puzzle_new(size);
+
+  for (guint y = 0; y < size; y++) {
+    for (guint x = 0; x < size; x++) {
+      puzzle->tile_ids[x * size + y] = tiles[y * size + x];
+      puzzle->num_tiles = MAX(puzzle->num_tiles, tiles[y * size + x] + 1u);
+    }
+  }
+  memcpy(puzzle->row_clues, row_clues, size);
+  memcpy(puzzle->col_clues, col_clues, size);
+
+  return puzzle;
+}
+
+/* Meet-in-the-middle lists half the paintings, so keep it to small boards */
+#define TEST_MEET_MAX_TILES 48
+
+static void assert_count(const TilepaintPuzzle *puzzle, guint expected) {
+  for (guint i = 0; i < G_N_ELEMENTS(engines); i++) {
+    if (engines[i] == TILEPAINT_SOLVER_MEET_IN_MIDDLE &&
+        puzzle->num_tiles > TEST_MEET_MAX_TILES)
+      continue;
+
+    g_assert_cmpuint(
+        tilepaint_solver_count(puzzle, engines[i], G_MAXUINT, NULL, NULL,
+                               NULL),
+        ==, expected);
+  }
+}
+
+static void test_known_boards(void) {
+  /* Four single cells with one painted in each line: either diagonal */
+  const guint16 singles[] = {0, 1, 2, 3};
+  const guchar ones[] = {1, 1};
+  /* The same clues, but the top row is one tile */
+  const guint16 top_row[] = {0, 0, 1, 2};
+  const guchar top_rows[] = {2, 0};
+  /* A 3×3 with an L-shaped tile that fixes everything */
+  const guint16 ell[] = {0, 1, 1, 0, 2, 3, 0, 0, 3};
+  const guchar ell_rows[] = {1, 1, 2};
+  const guchar ell_cols[] = {3, 1, 0};
+  TilepaintPuzzle *puzzle;
+
+  puzzle = make_puzzle(2, singles, ones, ones);
+  assert_count(puzzle, 2);
+  tilepaint_puzzle_free(puzzle);
+
+  puzzle = make_puzzle(2, top_row, ones, ones);
+  assert_count(puzzle, 0);
+  tilepaint_puzzle_free(puzzle);
+
+  puzzle = make_puzzle(2, top_row, top_rows, ones);
+  assert_count(puzzle, 1);
+  tilepaint_puzzle_free(puzzle);
+
+  puzzle = make_puzzle(3, ell, ell_rows, ell_cols);
+  assert_count(puzzle, 1);
+  tilepaint_puzzle_free(puzzle);
+}
+
+static void test_stats(void) {
+  /* Propagation alone solves this, so it needs no branching */
+  const guint16 ell[] = {0, 1, 1, 0, 2, 3, 0, 0, 3};
+  const guchar ell_rows[] = {1, 1, 2};
+  const guchar ell_cols[] = {3, 1, 0};
+  TilepaintPuzzle *puzzle = make_puzzle(3, ell, ell_rows, ell_cols);
+  TilepaintSolverStats stats = {0};
+
+  tilepaint_solver_count(puzzle, TILEPAINT_SOLVER_PROPAGATE, G_MAXUINT, NULL,
+                         NULL, &stats);
+  g_assert_cmpuint(stats.nodes, ==, 1);
+
+  /* Counts add up */
+  tilepaint_solver_count(puzzle, TILEPAINT_SOLVER_SEARCH, G_MAXUINT, NULL, NULL,
+                         &stats);
+  g_assert_cmpuint(stats.nodes, >, 1);
+
+  tilepaint_puzzle_free(puzzle);
+}
+
+static void test_witness(void) {
+  /* Four single cells with one painted in each line: either diagonal */
+  const guint16 singles[] = {0, 1, 2, 3};
+  const guchar ones[] = {1, 1};
+  TilepaintPuzzle *puzzle = make_puzzle(2, singles, ones, ones);
+  guchar witness[4];
+  guint n_solutions;
+
+  /* The intended solution is the main diagonal, so the witness is the other
+   * one */
+  puzzle->solution[0] = puzzle->solution[3] = 1;
+  g_assert_true(tilepaint_solver_find_witness(puzzle, G_MAXUINT, NULL, NULL,
+                                              NULL, witness, &n_solutions));
+  g_assert_cmpuint(n_solutions, ==, 2);
+  g_assert_cmpuint(witness[0], ==, 0);
+  g_assert_cmpuint(witness[1], ==, 1);
+  g_assert_cmpuint(witness[2], ==, 1);
+  g_assert_cmpuint(witness[3], ==, 0);
+
+  tilepaint_puzzle_free(puzzle);
+}
+
+static void test_many_small_tiles(void) {
+  /* One tile per cell, with one row clue short of the column clues: there
+   * is no solution, but proving it means exploring the assignments that
+   * leave the same clues unmet in many different ways */
+  TilepaintPuzzle *puzzle = tilepaint_puzzle_new(6);
+  TilepaintSolverStats stats = {0};
+
+  puzzle->num_tiles = 36;
+  for (guint i = 0; i < 36; i++)
+    puzzle->tile_ids[i] = i;
+  memset(puzzle->row_clues, 3, 6);
+  memset(puzzle->col_clues, 3, 6);
+  puzzle->row_clues[0] = 2;
+
+  assert_count(puzzle, 0);
+
+  g_assert_cmpuint(tilepaint_solver_count(puzzle, TILEPAINT_SOLVER_SEARCH,
+                                          G_MAXUINT, NULL, NULL, &stats),
+                   ==, 0);
+  g_assert_cmpuint(stats.memo_hits, >, 0);
+
+  tilepaint_puzzle_free(puzzle);
+}
+
+static void test_generated_boards(void) {
+  TilepaintGeneratorStats stats = {0};
+  gchar *json, *expected;
+
+  for (guint size = 1; size <= TILEPAINT_PUZZLE_MAX_SIZE; size++) {
+    TilepaintGeneratorOptions options = {size, 1, &stats};
+    TilepaintPuzzle *puzzle = tilepaint_puzzle_generate(size, &options, NULL);
+    guchar witness[TILEPAINT_PUZZLE_MAX_SIZE * TILEPAINT_PUZZLE_MAX_SIZE];
+
+    assert_count(puzzle, 1);
+    g_assert_false(tilepaint_solver_find_witness(puzzle, G_MAXUINT, NULL, NULL,
+                                                 NULL, witness, NULL));
+    tilepaint_puzzle_free(puzzle);
+  }
+
+  g_assert_cmpuint(stats.boards, ==, TILEPAINT_PUZZLE_MAX_SIZE);
+  g_assert_cmpuint(stats.attempts, >=, stats.boards);
+  g_assert_cmpuint(stats.solver.nodes, >=, stats.attempts);
+
+  json = tilepaint_generator_stats_to_json(&stats, 0);
+  expected = g_strdup_printf("\"boards\": %d,", TILEPAINT_PUZZLE_MAX_SIZE);
+  g_assert_nonnull(strstr(json, expected));
+  g_free(expected);
+  g_free(json);
+}
+
+/* Boards generated to a difficulty are of that difficulty, and rating them
+ * again from a plain count agrees with the generator */
+static void test_difficulty(void) {
+  for (guint d = TILEPAINT_DIFFICULTY_EASY; d <= TILEPAINT_DIFFICULTY_HARD;
+       d++) {
+    TilepaintGeneratorStats stats = {0};
+
+    g_assert_cmpuint(tilepaint_difficulty_from_string(
+                         tilepaint_difficulty_to_string(d)),
+                     ==, d);
+
+    for (guint seed = 1; seed <= 5; seed++) {
+      TilepaintGeneratorOptions options = {seed, 1, &stats, d};
+      TilepaintPuzzle *puzzle = tilepaint_puzzle_generate(10, &options, NULL);
+      TilepaintSolverStats solver_stats = {0};
+
+      g_assert_cmpuint(puzzle->difficulty, ==, d);
+      g_assert_cmpuint(tilepaint_solver_count(puzzle,
+                                              TILEPAINT_SOLVER_PROPAGATE,
+                                              G_MAXUINT, NULL, NULL,
+                                              &solver_stats),
+                       ==, 1);
+      g_assert_cmpuint(
+          tilepaint_difficulty_from_stats(&solver_stats, puzzle->num_tiles),
+          ==, d);
+      tilepaint_puzzle_free(puzzle);
+    }
+
+    g_assert_cmpuint(stats.boards + stats.off_target, <=, stats.attempts);
+  }
+
+  g_assert_cmpuint(tilepaint_difficulty_from_string("nonsense"), ==,
+                   TILEPAINT_DIFFICULTY_ANY);
+}
+
+/* A 3×3 board never needs trial and error, so asking for a hard one must
+ * still give a unique board eventually */
+static void test_difficulty_fallback(void) {
+  TilepaintGeneratorOptions options = {1, 1, NULL, TILEPAINT_DIFFICULTY_HARD};
+  TilepaintPuzzle *puzzle = tilepaint_puzzle_generate(3, &options, NULL);
+
+  assert_count(puzzle, 1);
+  g_assert_cmpuint(puzzle->difficulty, !=, TILEPAINT_DIFFICULTY_ANY);
+  tilepaint_puzzle_free(puzzle);
+}
+
+/* Hands out copies of one board, as the application does prefetched ones */
+static TilepaintPuzzle *ready_board_cb(guint size, gpointer user_data) {
+  const TilepaintPuzzle *ready = user_data;
+  TilepaintPuzzle *puzzle;
+
+  g_assert_cmpuint(size, ==, ready->size);
+  puzzle = tilepaint_puzzle_transform(ready, 0);
+  puzzle->difficulty = ready->difficulty;
+
+  return puzzle;
+}
+
+/* Running out of time gives a unique board, rated as it solves, whether the
+ * first unique one of any difficulty or, the second time round, an earlier
+ * board turned or mirrored. A ready-made board is given in preference, as it
+ * is. 3×3 boards are never hard, so asking for one always runs out of time. */
+static void test_time_budget(void) {
+  TilepaintGeneratorOptions ready_options = {99, 1};
+  TilepaintPuzzle *ready = tilepaint_puzzle_generate(3, &ready_options, NULL);
+
+  for (guint mode = 0; mode < 3; mode++) {
+    TilepaintGeneratorStats stats = {0};
+    TilepaintGeneratorOptions options = {1, mode == 1 ? 4 : 1, &stats,
+                                         TILEPAINT_DIFFICULTY_HARD, 1};
+
+    for (guint i = 1; i <= 3; i++) {
+      TilepaintSolverStats solve_stats = {0};
+      TilepaintPuzzle *puzzle;
+
+      options.seed = i;
+      if (i == 3) {
+        options.fallback = ready_board_cb;
+        options.fallback_data = ready;
+      }
+      if (mode == 2) {
+        TilepaintGenerator *generator = tilepaint_generator_new(3, &options);
+
+        while (!tilepaint_generator_step(generator, 1))
+          ;
+        puzzle = tilepaint_generator_steal_puzzle(generator);
+        tilepaint_generator_free(generator);
+      } else {
+        puzzle = tilepaint_puzzle_generate(3, &options, NULL);
+      }
+
+      assert_count(puzzle, 1);
+      tilepaint_solver_count(puzzle, TILEPAINT_SOLVER_PROPAGATE, G_MAXUINT,
+                             NULL, NULL, &solve_stats);
+      g_assert_cmpuint(puzzle->difficulty, ==,
+                       tilepaint_difficulty_from_stats(&solve_stats,
+                                                       puzzle->num_tiles));
+      g_assert_cmpuint(stats.boards, ==, i);
+      g_assert_cmpuint(stats.fallbacks, ==, i);
+      if (i == 3)
+        g_assert_cmpuint(tilepaint_puzzle_fingerprint(puzzle), ==,
+                         tilepaint_puzzle_fingerprint(ready));
+      tilepaint_puzzle_free(puzzle);
+    }
+  }
+
+  tilepaint_puzzle_free(ready);
+}
+
+static void assert_stats_equal(const TilepaintSolverStats *a,
+                               const TilepaintSolverStats *b) {
+  g_assert_cmpuint(a->nodes, ==, b->nodes);
+  g_assert_cmpuint(a->memo_hits, ==, b->memo_hits);
+  g_assert_cmpuint(a->overshoot_prunes, ==, b->overshoot_prunes);
+  g_assert_cmpuint(a->shortfall_prunes, ==, b->shortfall_prunes);
+  g_assert_cmpuint(a->subset_deductions, ==, b->subset_deductions);
+  g_assert_cmpuint(a->max_depth, ==, b->max_depth);
+}
+
+/* Splits the top row into single-cell tiles, which leaves most boards
+ * ambiguous */
+static void split_top_row(TilepaintPuzzle *puzzle) {
+  guint size = puzzle->size;
+  guint16 *renumber = g_new(guint16, puzzle->num_tiles + size);
+  guint16 n_tiles = 0;
+
+  for (guint x = 0; x < size; x++)
+    puzzle->tile_ids[x * size] = puzzle->num_tiles + x;
+
+  memset(renumber, 0xff, (puzzle->num_tiles + size) * sizeof(guint16));
+  for (guint i = 0; i < size * size; i++) {
+    guint16 *tile = &renumber[puzzle->tile_ids[i]];
+
+    if (*tile == G_MAXUINT16)
+      *tile = n_tiles++;
+    puzzle->tile_ids[i] = *tile;
+  }
+
+  puzzle->num_tiles = n_tiles;
+  g_free(renumber);
+}
+
+/* Solving a node at a time matches solving in one go, on unique boards and
+ * on ambiguous ones */
+static void test_steps(void) {
+  for (guint size = 2; size <= TILEPAINT_PUZZLE_MAX_SIZE; size += 4) {
+    TilepaintGeneratorOptions options = {size, 1};
+    TilepaintPuzzle *puzzle = tilepaint_puzzle_generate(size, &options, NULL);
+
+    for (guint ambiguous = 0; ambiguous <= 1; ambiguous++) {
+      guchar expected[TILEPAINT_PUZZLE_MAX_SIZE * TILEPAINT_PUZZLE_MAX_SIZE];
+      guchar witness[TILEPAINT_PUZZLE_MAX_SIZE * TILEPAINT_PUZZLE_MAX_SIZE];
+      TilepaintSolverStats one_go = {0}, steps = {0};
+      TilepaintSolver *solver;
+      gboolean found;
+      guint n_solutions;
+
+      if (ambiguous)
+        split_top_row(puzzle);
+
+      for (guint i = 0; i < 2; i++) {
+        guint count;
+
+        memset(&one_go, 0, sizeof(one_go));
+        memset(&steps, 0, sizeof(steps));
+        count = tilepaint_solver_count(puzzle, engines[i], G_MAXUINT, NULL,
+                                       NULL, &one_go);
+
+        solver = tilepaint_solver_new(puzzle, engines[i], G_MAXUINT);
+        while (!tilepaint_solver_step(solver, 1))
+          ;
+        g_assert_cmpuint(tilepaint_solver_get_n_solutions(solver), ==, count);
+        tilepaint_solver_get_stats(solver, &steps);
+        assert_stats_equal(&one_go, &steps);
+        tilepaint_solver_free(solver);
+      }
+
+      memset(&one_go, 0, sizeof(one_go));
+      memset(&steps, 0, sizeof(steps));
+      found = tilepaint_solver_find_witness(puzzle, G_MAXUINT, NULL, NULL,
+                                            &one_go, expected, &n_solutions);
+
+      solver = tilepaint_solver_new_witness(puzzle, G_MAXUINT);
+      while (!tilepaint_solver_step(solver, 1))
+        ;
+      g_assert_cmpuint(tilepaint_solver_get_n_solutions(solver), ==,
+                       n_solutions);
+      g_assert_cmpint(tilepaint_solver_get_witness(solver, witness), ==,
+                      found);
+      if (found)
+        g_assert_cmpmem(witness, size * size, expected, size * size);
+      tilepaint_solver_get_stats(solver, &steps);
+      assert_stats_equal(&one_go, &steps);
+      tilepaint_solver_free(solver);
+    }
+
+    tilepaint_puzzle_free(puzzle);
+  }
+}
+
+static void assert_puzzles_equal(const TilepaintPuzzle *a,
+                                 const TilepaintPuzzle *b) {
+  g_assert_cmpuint(a->size, ==, b->size);
+  g_assert_cmpuint(a->num_tiles, ==, b->num_tiles);
+  g_assert_cmpuint(a->difficulty, ==, b->difficulty);
+  g_assert_cmpmem(a->tile_ids, a->size * a->size * sizeof(*a->tile_ids),
+                  b->tile_ids, b->size * b->size * sizeof(*b->tile_ids));
+  g_assert_cmpmem(a->solution, a->size * a->size, b->solution,
+                  b->size * b->size);
+}
+
+/* Generating a node at a time gives the board generating in one go does, and
+ * a generation can be dropped halfway */
+static void test_generator_steps(void) {
+  for (guint size = 1; size <= TILEPAINT_PUZZLE_MAX_SIZE; size += 3) {
+    TilepaintGeneratorOptions options = {size, 1, NULL,
+                                         TILEPAINT_DIFFICULTY_MEDIUM};
+    TilepaintPuzzle *expected = tilepaint_puzzle_generate(size, &options, NULL);
+    TilepaintGenerator *generator = tilepaint_generator_new(size, &options);
+    TilepaintPuzzle *puzzle;
+
+    while (!tilepaint_generator_step(generator, 1))
+      ;
+    puzzle = tilepaint_generator_steal_puzzle(generator);
+    tilepaint_generator_free(generator);
+
+    assert_puzzles_equal(expected, puzzle);
+    tilepaint_puzzle_free(expected);
+    tilepaint_puzzle_free(puzzle);
+
+    generator = tilepaint_generator_new(size, &options);
+    tilepaint_generator_step(generator, 1);
+    tilepaint_generator_free(generator);
+  }
+}
+
+typedef struct {
+  GMainLoop *loop;
+  TilepaintPuzzle *puzzle;
+  GError *error;
+} IdleResult;
+
+static void generate_idle_cb(GObject *source, GAsyncResult *result,
+                             gpointer user_data) {
+  IdleResult *idle = user_data;
+
+  idle->puzzle = tilepaint_puzzle_generate_idle_finish(result, &idle->error);
+  g_main_loop_quit(idle->loop);
+}
+
+/* Generating from an idle source gives the same board, and stops when
+ * cancelled */
+static void test_generate_idle(void) {
+  TilepaintGeneratorStats stats = {0};
+  TilepaintGeneratorOptions options = {1, 1, &stats};
+  TilepaintPuzzle *expected = tilepaint_puzzle_generate(20, &options, NULL);
+  IdleResult idle = {g_main_loop_new(NULL, FALSE), NULL, NULL};
+  GCancellable *cancellable = g_cancellable_new();
+
+  tilepaint_puzzle_generate_idle_async(20, &options, NULL, generate_idle_cb,
+                                       &idle);
+  g_main_loop_run(idle.loop);
+  g_assert_no_error(idle.error);
+  assert_puzzles_equal(expected, idle.puzzle);
+  g_assert_cmpuint(stats.boards, ==, 2);
+  tilepaint_puzzle_free(idle.puzzle);
+
+  g_cancellable_cancel(cancellable);
+  tilepaint_puzzle_generate_idle_async(20, &options, cancellable,
+                                       generate_idle_cb, &idle);
+  g_main_loop_run(idle.loop);
+  g_assert_error(idle.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null(idle.puzzle);
+  g_assert_cmpuint(stats.boards, ==, 2);
+
+  g_clear_error(&idle.error);
+  g_object_unref(cancellable);
+  g_main_loop_unref(idle.loop);
+  tilepaint_puzzle_free(expected);
+}
+
+int main(int argc, char *argv[]) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/solver/known_boards", test_known_boards);
+  g_test_add_func("/solver/stats", test_stats);
+  g_test_add_func("/solver/witness", test_witness);
+  g_test_add_func("/solver/many_small_tiles", test_many_small_tiles);
+  g_test_add_func("/solver/generated_boards", test_generated_boards);
+  g_test_add_func("/solver/difficulty", test_difficulty);
+  g_test_add_func("/solver/difficulty_fallback", test_difficulty_fallback);
+  g_test_add_func("/solver/time_budget", test_time_budget);
+  g_test_add_func("/solver/steps", test_steps);
+  g_test_add_func("/solver/generator_steps", test_generator_steps);
+  g_test_add_func("/solver/generate_idle", test_generate_idle);
+  return g_test_run();
+}
@@ -0,0 +1,131 @@
+/* test-undo.c — exercises the undo history's ring buffer.
+ *
+ * Links the production undo.c: moves must come back in reverse order when
+ * undone and in order when redone, a new move must forget the undone ones,
+ * clearing must forget everything, and with a limit only the newest moves
+ * may be kept, across the buffer wrapping round and growing. Joined moves
+ * must be told apart so that a drag can be undone and redone as one step.
+ */
+#include <glib.h>
+#include "../src/undo.h"
+
+static void assert_record(const TilepaintUndoRecord *record, guint8 type,
+                          guint8 x, guint8 y) {
+  g_assert_nonnull(record);
+  g_assert_cmpuint(record->type, ==, type);
+  g_assert_cmpuint(record->x, ==, x);
+  g_assert_cmpuint(record->y, ==, y);
+}
+
+static void test_undo_redo(void) {
+  TilepaintUndoHistory *history = tilepaint_undo_history_new(0);
+  guint i;
+
+  g_assert_false(tilepaint_undo_history_can_undo(history));
+  g_assert_false(tilepaint_undo_history_can_redo(history));
+  g_assert_null(tilepaint_undo_history_undo(history));
+
+  /* Enough moves for the buffer to grow a few times */
+  for (i = 0; i < 1000; i++)
+    tilepaint_undo_history_push(history, i % 4, i % 30, i / 30, FALSE);
+
+  for (i = 1000; i-- > 500;)
+    assert_record(tilepaint_undo_history_undo(history), i % 4, i % 30, i / 30);
+  g_assert_true(tilepaint_undo_history_can_redo(history));
+
+  for (i = 500; i < 700; i++)
+    assert_record(tilepaint_undo_history_redo(history), i % 4, i % 30, i / 30);
+
+  /* A new move forgets the 300 undone ones */
+  tilepaint_undo_history_push(history, 3, 29, 29, FALSE);
+  g_assert_false(tilepaint_undo_history_can_redo(history));
+  g_assert_null(tilepaint_undo_history_redo(history));
+  assert_record(tilepaint_undo_history_undo(history), 3, 29, 29);
+  assert_record(tilepaint_undo_history_undo(history), 699 % 4, 699 % 30,
+                699 / 30);
+
+  tilepaint_undo_history_clear(history);
+  g_assert_false(tilepaint_undo_history_can_undo(history));
+  g_assert_false(tilepaint_undo_history_can_redo(history));
+
+  tilepaint_undo_history_push(history, 1, 2, 3, FALSE);
+  assert_record(tilepaint_undo_history_undo(history), 1, 2, 3);
+  g_assert_null(tilepaint_undo_history_undo(history));
+  assert_record(tilepaint_undo_history_redo(history), 1, 2, 3);
+
+  tilepaint_undo_history_free(history);
+}
+
+static void test_max_records(void) {
+  TilepaintUndoHistory *history = tilepaint_undo_history_new(100);
+  guint i, n_undone = 0;
+
+  /* Pushing past the limit wraps round the buffer many times over */
+  for (i = 0; i < 1000; i++) {
+    tilepaint_undo_history_push(history, 0, i % 256, i / 256, FALSE);
+
+    /* Undoing and redoing part way mustn't upset the wrapping */
+    if (i % 37 == 0) {
+      assert_record(tilepaint_undo_history_undo(history), 0, i % 256,
+                    i / 256);
+      assert_record(tilepaint_undo_history_redo(history), 0, i % 256,
+                    i / 256);
+    }
+  }
+
+  while (tilepaint_undo_history_can_undo(history)) {
+    i--;
+    assert_record(tilepaint_undo_history_undo(history), 0, i % 256, i / 256);
+    n_undone++;
+  }
+
+  g_assert_cmpuint(n_undone, ==, 100);
+
+  tilepaint_undo_history_free(history);
+}
+
+static void test_joined(void) {
+  TilepaintUndoHistory *history = tilepaint_undo_history_new(0);
+  const TilepaintUndoRecord *record;
+
+  /* A click, then a drag over three cells */
+  tilepaint_undo_history_push(history, 0, 0, 0, FALSE);
+  tilepaint_undo_history_push(history, 0, 1, 0, FALSE);
+  tilepaint_undo_history_push(history, 0, 2, 0, TRUE);
+  tilepaint_undo_history_push(history, 0, 3, 0, TRUE);
+
+  /* Undoing the drag steps back until a move which isn't joined */
+  record = tilepaint_undo_history_undo(history);
+  assert_record(record, 0, 3, 0);
+  g_assert_true(record->joined);
+  record = tilepaint_undo_history_undo(history);
+  assert_record(record, 0, 2, 0);
+  g_assert_true(record->joined);
+  record = tilepaint_undo_history_undo(history);
+  assert_record(record, 0, 1, 0);
+  g_assert_false(record->joined);
+
+  /* Redoing it steps forward while the next move is joined */
+  assert_record(tilepaint_undo_history_redo(history), 0, 1, 0);
+  g_assert_true(tilepaint_undo_history_redo_is_joined(history));
+  assert_record(tilepaint_undo_history_redo(history), 0, 2, 0);
+  g_assert_true(tilepaint_undo_history_redo_is_joined(history));
+  assert_record(tilepaint_undo_history_redo(history), 0, 3, 0);
+  g_assert_false(tilepaint_undo_history_redo_is_joined(history));
+
+  tilepaint_undo_history_undo(history);
+  tilepaint_undo_history_undo(history);
+  tilepaint_undo_history_undo(history);
+  tilepaint_undo_history_undo(history);
+  g_assert_false(tilepaint_undo_history_redo_is_joined(history));
+
+  tilepaint_undo_history_free(history);
+}
+
+int main(int argc, char *argv[]) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/undo/undo_redo", test_undo_redo);
+  g_test_add_func("/undo/max_records", test_max_records);
+  g_test_add_func("/undo/joined", test_joined);
+  return g_test_run();
+}
@@ -38,13 +38,14 @@ void tilepaint_show_win_dialog(Tilepaint *tilepaint) {
 /* Build a solved board: paint a fixed pattern, then derive the row/column
  * clues from it so the board exactly satisfies both rules. */
 static void build_solved_board(TilepaintApplication *app, int size) {
-  static TilepaintCell *rows[MAX_BOARD_SIZE];
-  static TilepaintCell cells[MAX_BOARD_SIZE][MAX_BOARD_SIZE];
+  static TilepaintCell cells[MAX_BOARD_SIZE * MAX_BOARD_SIZE];
+  static guchar row_clues[MAX_BOARD_SIZE];
+  static guchar col_clues[MAX_BOARD_SIZE];
 
   memset(cells, 0, sizeof(cells));
-  for (int x = 0; x < size; x++)
-    rows[x] = cells[x];
-  app->board = rows;
+  app->board = cells;
+  app->row_clues = row_clues;
+  app->col_clues = col_clues;
   app->board_size = size;
   app->settings = NULL; /* not consulted by the rules or the stubs */
   app->timer_value = 42;
@@ -52,24 +53,26 @@ static void build_solved_board(TilepaintApplication *app, int size) {
   for (int y = 0; y < size; y++) {
     for (int x = 0; x < size; x++) {
       if ((x + y) % 3 == 0)
-        cells[x][y].status |= CELL_PAINTED;
+        tilepaint_toggle_cell(app, x, y, CELL_PAINTED);
     }
   }
 
   for (int y = 0; y < size; y++) {
     int count = 0;
     for (int x = 0; x < size; x++)
-      if (cells[x][y].status & CELL_PAINTED)
+      if (tilepaint_cell(app, x, y)->status & CELL_PAINTED)
         count++;
     app->row_clues[y] = (guchar)count;
   }
   for (int x = 0; x < size; x++) {
     int count = 0;
     for (int y = 0; y < size; y++)
-      if (cells[x][y].status & CELL_PAINTED)
+      if (tilepaint_cell(app, x, y)->status & CELL_PAINTED)
         count++;
     app->col_clues[x] = (guchar)count;
   }
+
+  tilepaint_count_lines(app);
 }
 
 static void test_win_independent_of_feedback(void) {
@@ -106,16 +109,96 @@ static void test_no_win_when_overpainted(void) {
   /* Over-paint one extra cell: row 0 and its column now exceed their clues,
    * which is exactly the state that renders red under feedback — it must
    * also block victory regardless of the preference. */
-  app.board[4][0].status |= CELL_PAINTED;
+  tilepaint_toggle_cell(&app, 4, 0, CELL_PAINTED);
   g_assert_false(tilepaint_check_win(&app));
   g_assert_false(win_dialog_called);
 }
 
+/* Whether the board has won is kept count of as cells are toggled; it must
+ * always agree with checking every line */
+static void test_win_tracks_toggles(void) {
+  TilepaintApplication app;
+  GRand *rng = g_rand_new_with_seed(11);
+  guint n_wins = 0;
+
+  memset(&app, 0, sizeof(app));
+  build_solved_board(&app, 3);
+
+  for (int i = 0; i < 10000; i++) {
+    gboolean won;
+
+    tilepaint_toggle_cell(&app, g_rand_int_range(rng, 0, 3),
+                          g_rand_int_range(rng, 0, 3), CELL_PAINTED);
+
+    won = tilepaint_check_rule2(&app) && tilepaint_check_rule3(&app);
+    win_dialog_called = FALSE;
+    g_assert_cmpint(tilepaint_check_win(&app), ==, won);
+    g_assert_cmpint(win_dialog_called, ==, won);
+    n_wins += won;
+
+    for (int line = 0; line < 3; line++) {
+      g_assert_cmpuint(app.row_counts[line], ==,
+                       tilepaint_bitplane_row_count(&app.painted, line));
+      g_assert_cmpuint(app.col_counts[line], ==,
+                       tilepaint_bitplane_col_count(&app.painted, line));
+    }
+  }
+
+  /* A 3×3 board has few enough paintings that random toggles come back to
+   * a solution now and then */
+  g_assert_cmpuint(n_wins, >, 0);
+
+  g_rand_free(rng);
+}
+
+static void test_bitplanes_match_cells(void) {
+  TilepaintApplication app;
+  GRand *rng = g_rand_new_with_seed(7);
+  const guchar flags[] = {CELL_PAINTED, CELL_TAG1, CELL_TAG2,
+                          CELL_TAG1 | CELL_TAG2};
+
+  memset(&app, 0, sizeof(app));
+  build_solved_board(&app, MAX_BOARD_SIZE);
+
+  /* Toggle cells at random, as play and undo would, then count each line
+   * both ways */
+  for (int i = 0; i < 10000; i++) {
+    tilepaint_toggle_cell(&app, g_rand_int_range(rng, 0, MAX_BOARD_SIZE),
+                          g_rand_int_range(rng, 0, MAX_BOARD_SIZE),
+                          flags[g_rand_int_range(rng, 0, G_N_ELEMENTS(flags))]);
+  }
+
+  for (int a = 0; a < MAX_BOARD_SIZE; a++) {
+    guint row_painted = 0, col_painted = 0, row_tagged = 0, col_tagged = 0;
+
+    for (int b = 0; b < MAX_BOARD_SIZE; b++) {
+      row_painted += (tilepaint_cell(&app, b, a)->status & CELL_PAINTED) != 0;
+      col_painted += (tilepaint_cell(&app, a, b)->status & CELL_PAINTED) != 0;
+      row_tagged += (tilepaint_cell(&app, b, a)->status & CELL_TAG2) != 0;
+      col_tagged += (tilepaint_cell(&app, a, b)->status & CELL_TAG2) != 0;
+    }
+
+    g_assert_cmpuint(tilepaint_bitplane_row_count(&app.painted, a), ==,
+                     row_painted);
+    g_assert_cmpuint(tilepaint_bitplane_col_count(&app.painted, a), ==,
+                     col_painted);
+    g_assert_cmpuint(tilepaint_bitplane_row_count(&app.tag2, a), ==,
+                     row_tagged);
+    g_assert_cmpuint(tilepaint_bitplane_col_count(&app.tag2, a), ==,
+                     col_tagged);
+  }
+
+  g_rand_free(rng);
+}
+
 int main(int argc, char *argv[]) {
   g_test_init(&argc, &argv, NULL);
   g_test_add_func("/win-path/independent_of_clue_feedback",
                   test_win_independent_of_feedback);
   g_test_add_func("/win-path/no_win_when_overpainted",
                   test_no_win_when_overpainted);
+  g_test_add_func("/win-path/win_tracks_toggles", test_win_tracks_toggles);
+  g_test_add_func("/win-path/bitplanes_match_cells",
+                  test_bitplanes_match_cells);
   return g_test_run();
 }